@@ -69,6 +69,13 @@ typedef struct                                          // 
 }CH_CN;
 
 
+//lookup table on the characters of a cFONT, created on first use
+typedef struct
+{
+  uint16_t *slot;                                       // character number + 1, 0 = empty
+  uint32_t mask;                                        // number of slots - 1
+}CN_INDEX;
+
 typedef struct
 {    
   const CH_CN *table;
@@ -76,6 +83,9 @@ typedef struct
   uint16_t ASCII_Width;
   uint16_t Width;
   uint16_t Height;
+  CN_INDEX *lookup;                                     // leave out (NULL) in a font file
+  const uint8_t *codes;                                 // table NULL: 2 bytes per character
+  const uint8_t *bitmap;                                // table NULL: Height x bytes of Width
   
 }cFONT;
 
@@ -29,6 +29,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  * *****************************************************************/
   
+#define _GNU_SOURCE              // S_ISSOCK(), accept4()
 # include "epaper.h"
 
 # define VERSION "1.0,1 September 2020"
@@ -44,6 +45,27 @@ UBYTE   *RedImage = 0x0;
 /* indicate status of HW */
 bool BCM_init = false;                  // BCM was initialised
 bool EPD_DisplayOn = false;             // display is turned on
+bool EPD_Awake = false;                 // display initialised, not in deep sleep
+int Idle_Sleep = 0;                     // seconds the display stays awake after a request (-i)
+uint64_t Sleep_At = 0;                  // now_ms() to set the awake display to deep sleep
+bool EPD_PanelValid = false;            // panel shows the images (except the changed area)
+bool Partial_Update = false;            // only send the changed area to the display
+uint64_t EPD_PanelHash = 0;             // EPD_FrameHash() of the images on the panel
+unsigned int Frames_Displayed = 0;      // frames sent to the display
+unsigned int Frames_Skipped = 0;        // frames not sent, already on the display
+unsigned int Frames_Coalesced = 0;      // frames replaced by a later frame (-L)
+EPD_FRAME Frame_File = {0};             // last frame file loaded (I=)
+bool Frame_Pending = false;             // images were loaded from Frame_File
+UBYTE *Prev_Black = NULL;               // images of the previous frame (-u)
+UBYTE *Prev_Red = NULL;
+bool Prev_Valid = false;                // Prev_Black and Prev_Red are set
+DISPLAY_LIST DL_Cache[DL_CACHE];        // compiled instructions
+UDOUBLE DL_Clock = 0;                   // last use of a display list
+unsigned int DL_Reused = 0;             // instructions not compiled again
+unsigned int DL_Compiled = 0;           // instructions compiled
+TEMPLATE Templates[TPL_MAX];            // defined templates
+TEMPLATE *DL_Template = NULL;           // template being compiled
+char *DL_Value[TPL_VARS];               // values of the template being drawn
 
 /* hold the provided instructions */
 char Instruction[MAXINSTRUCTIONS];
@@ -51,9 +73,36 @@ char Instruction[MAXINSTRUCTIONS];
 /* hold pipe info */
 char name_pipe_w[MAXFILENAME] = "./EPD_from";   // can be overruled from command line
 char name_pipe_r[MAXFILENAME] = "./EPD_to";     // can be overruled from command line
-int p_fd_r = -1;                        // pipe handles
-int p_fd_w = -1;
+char name_socket[MAXFILENAME] = "";     // unix socket to listen on (-S)
+CLIENT Clients[MAXCLIENTS + 1];         // [0] = named pipes, then socket clients
+int sock_fd = -1;                       // listening socket
+int ep_fd = -1;                         // epoll handle
+int close_fd = -1;                      // eventfd, the panel thread asks to close down (-A)
 #define BUFSIZE 512                      // internal buffer size
+RENDER_REQ RQ[RQ_MAX];                  // render queue
+int RQ_Head = 0;                        // first request in the queue
+int RQ_Count = 0;                       // requests in the queue
+pthread_mutex_t RQ_Lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t RQ_Ready = PTHREAD_COND_INITIALIZER;    // request added
+pthread_cond_t RQ_Space = PTHREAD_COND_INITIALIZER;    // request taken
+pthread_mutex_t Client_Lock = PTHREAD_MUTEX_INITIALIZER;  // writing to or closing a client
+UDOUBLE Client_Serial = 0;              // last connection number
+
+/* asynchronous render and panel threads (-A) */
+bool Async = false;                     // use the threads
+bool Threads_Started = false;
+pthread_mutex_t Close_Lock = PTHREAD_MUTEX_INITIALIZER;
+bool Closing = false;                   // close_out() has started
+pthread_t Render_Tid, Panel_Tid;
+PANEL_JOB PQ[PQ_MAX];                   // panel queue
+int PQ_Head = 0;                        // first job in the panel queue
+int PQ_Count = 0;                       // jobs in the panel queue (incl. the one displayed)
+pthread_mutex_t PQ_Lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t PQ_Ready = PTHREAD_COND_INITIALIZER;    // job added
+pthread_cond_t PQ_Done = PTHREAD_COND_INITIALIZER;     // job done
+bool Frame_Staged = false;              // request has a frame to display
+bool Latest_Wins = false;               // replace a waiting frame by a later one (-L)
+bool Panel_Direct = false;              // render thread uses the panel, see panel_wait()
 
 /*********************************************************************
  * @brief Display in color
@@ -101,6 +150,26 @@ void p_printf(int level, char *format, ...) {
     free(col);
 }
 
+/**
+ * @brief stop the render and panel threads (-A)
+ */
+void stop_threads()
+{
+    if (! Threads_Started) return;
+
+    Threads_Started = false;
+
+    if (! pthread_equal(pthread_self(), Render_Tid)) {
+        pthread_cancel(Render_Tid);
+        pthread_join(Render_Tid, NULL);
+    }
+
+    if (! pthread_equal(pthread_self(), Panel_Tid)) {
+        pthread_cancel(Panel_Tid);
+        pthread_join(Panel_Tid, NULL);
+    }
+}
+
 /**
  * System Exit
  * 
@@ -108,21 +177,95 @@ void p_printf(int level, char *format, ...) {
  */
 void close_out(int ret)
 {
+    UDOUBLE hits, misses;
+    sigset_t set;
+    int i;
+    
+    // close down once, not again from Ctrl-C or another thread
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &set, NULL);
+    
+    pthread_mutex_lock(&Close_Lock);
+    
+    if (Closing) {
+        pthread_mutex_unlock(&Close_Lock);
+        
+        // the first caller exits (or stops this thread)
+        while (1) pause();
+    }
+    
+    Closing = true;
+    pthread_mutex_unlock(&Close_Lock);
+    
+    // the panel is used by this thread only from here
+    stop_threads();
+    
+    if (Frames_Skipped > 0)
+        printf("%u frames displayed, %u skipped as unchanged\r\n", Frames_Displayed, Frames_Skipped);
+    
+    if (Frames_Coalesced > 0)
+        printf("%u frames replaced by a later frame before display\r\n", Frames_Coalesced);
+    
+    Paint_GlyphStats(&hits, &misses);
+    if (hits + misses > 0)
+        Debug("glyph cache: %u hits, %u misses\r\n", hits, misses);
+    
+    EPD_PackedStats(&hits, &misses);
+    if (hits + misses > 0)
+        Debug("packed frames: %u reused, %u packed\r\n", hits, misses);
+    
+    if (DL_Reused + DL_Compiled > 0)
+        Debug("display lists: %u reused, %u compiled\r\n", DL_Reused, DL_Compiled);
+    
     if (EPD_DisplayOn) {
         printf("\r\nClosing down Epaper:Goto Sleep mode\r\n");
         EPD_Sleep();
+        EPD_Awake = false;
     }
     
     if (BCM_init)    DEV_ModuleExit();
 
-    // if open pipes
-    if (p_fd_r  > 0)  close(p_fd_r);
-    if (p_fd_w  > 0)  close(p_fd_w);
+    // if open pipes or socket clients
+    for (i = 0; i <= MAXCLIENTS; i++) {
+        if (Clients[i].Fd_r > 0)  close(Clients[i].Fd_r);
+        if (Clients[i].Fd_w > 0 && Clients[i].Fd_w != Clients[i].Fd_r)  close(Clients[i].Fd_w);
+    }
+    
+    if (sock_fd > 0) {
+        close(sock_fd);
+        unlink(name_socket);
+    }
+    
+    if (ep_fd > 0)  close(ep_fd);
+    
+    if (close_fd > 0)  close(close_fd);
+    
+    while (RQ_Count > 0) {
+        if (RQ[RQ_Head].Data != NULL) free(RQ[RQ_Head].Data);
+        RQ_Head = (RQ_Head + 1) % RQ_MAX;
+        RQ_Count--;
+    }
+    
+    for (i = 0; i < PQ_MAX; i++) {
+        if (PQ[i].Black != NULL) free(PQ[i].Black);
+        if (PQ[i].Red != NULL) free(PQ[i].Red);
+    }
 
+    EPD_FrameClose(&Frame_File);
+    
     // if memory allocated
     if (BlackImage != 0x0) free(BlackImage);
     if (RedImage != 0x0) free(RedImage);
+    if (Prev_Black != NULL) free(Prev_Black);
+    if (Prev_Red != NULL) free(Prev_Red);
+    
+    for (i = 0; i < DL_CACHE; i++)
+        if (DL_Cache[i].Used) free(DL_Cache[i].Op);
     
+    for (i = 0; i < TPL_MAX; i++)
+        if (Templates[i].List.Op != NULL) free(Templates[i].List.Op);
+
     exit(ret);
 }
 
@@ -135,9 +278,10 @@ void init_variables()
     IM_prop.Ystart = 0;                     // current Y position
     IM_prop.back_color = WHITE;             // default background color
     IM_prop.front_color = BLACK;            // default foreground color
-    strcpy (IM_prop.font, "font12");        // default font
+    IM_prop.font = Font_Find("font12");     // default font
     IM_prop.Xstart_back = 0xffff;           // backup place for Xstart
     IM_prop.Ystart_back = 0xffff;           // backup place for Ystart
+    IM_prop.dither = DITHER_NONE;           // images black and white
 }
 
 /**
@@ -145,14 +289,120 @@ void init_variables()
  */
 void hw_init()
 {
-    // initialise BCM2835
+    // initialise BCM2835 (or the selected backend)
     if (! BCM_init) {
-        DEV_ModuleInit();
+        if (DEV_ModuleInit()) {
+            p_printf(D_RED, "Could not initialise the hardware\n");
+            close_out(EXIT_FAILURE);
+        }
         BCM_init = true;
     }
 
     // initialise the epaper
     EPD_Init();
+    EPD_Awake = true;
+}
+
+/**
+ * @brief : monotonic time in ms
+ */
+uint64_t now_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/**
+ * @brief : set the display to deep sleep, if it is awake
+ */
+void panel_sleep()
+{
+    if (EPD_Awake) {
+        EPD_Sleep();
+        EPD_Awake = false;
+    }
+
+    EPD_DisplayOn = false;
+}
+
+/**
+ * @brief : the display is idle after a request
+ *
+ * Without idle window (-i) a display that was used goes to deep sleep
+ * right away. Else it stays awake, the next request does not need a reset
+ * and init, until the window has passed without requests.
+ */
+void panel_idle()
+{
+    if (Idle_Sleep == 0) {
+        if (EPD_DisplayOn) panel_sleep();
+    }
+    else if (EPD_Awake)
+        Sleep_At = now_ms() + (uint64_t) Idle_Sleep * 1000;
+}
+
+/**
+ * @brief : time until the display goes to deep sleep (-i)
+ *
+ * @return : ms, -1 = no idle window or the display is asleep
+ */
+int idle_timeout()
+{
+    uint64_t now;
+
+    if (Idle_Sleep == 0 || ! EPD_Awake) return(-1);
+
+    now = now_ms();
+
+    return(Sleep_At > now ? (int) (Sleep_At - now) : 0);
+}
+
+/**
+ * @brief : release a mutex when a thread is cancelled (-A)
+ *
+ * A thread cancelled while waiting for a condition holds the mutex.
+ */
+void unlock_mutex(void *m)
+{
+    pthread_mutex_unlock((pthread_mutex_t *) m);
+}
+
+/**
+ * @brief : wait until the panel thread has displayed the queued frames
+ *
+ * With -A only the panel thread uses the panel. An instruction that uses
+ * the panel directly (clear, border, sleep, init) waits for the frames
+ * that were drawn before it, and calls panel_done() when done.
+ */
+void panel_wait()
+{
+    if (! Async) return;
+
+    pthread_mutex_lock(&PQ_Lock);
+    pthread_cleanup_push(unlock_mutex, &PQ_Lock);
+
+    while (PQ_Count > 0) pthread_cond_wait(&PQ_Done, &PQ_Lock);
+
+    // the panel thread does not set the display to deep sleep now
+    Panel_Direct = true;
+
+    pthread_cleanup_pop(1);
+}
+
+/**
+ * @brief : the panel is no longer used directly, see panel_wait()
+ */
+void panel_done()
+{
+    if (! Async) return;
+
+    pthread_mutex_lock(&PQ_Lock);
+    Panel_Direct = false;
+    pthread_cond_signal(&PQ_Ready);
+    pthread_mutex_unlock(&PQ_Lock);
 }
 
 /**
@@ -160,12 +410,11 @@ void hw_init()
  */
 void reset_image()
 {
-    // Select Image
-    Paint_SelectImage(RedImage);
-    Paint_Clear(WHITE);
+    Paint_ImageFill(RedImage, WHITE);
+    Paint_ImageFill(BlackImage, WHITE);
      
+    // Select Image
     Paint_SelectImage(BlackImage);
-    Paint_Clear(WHITE);
 }
 
 /**
@@ -188,6 +437,17 @@ void image_init()
         close_out(EXIT_FAILURE);
     }
     
+    // compared with the next frame for the partial update (-u)
+    if (Partial_Update) {
+        Prev_Black = (UBYTE *) malloc(Imagesize);
+        Prev_Red = (UBYTE *) malloc(Imagesize);
+        
+        if (Prev_Black == NULL || Prev_Red == NULL) {
+            printf("Failed to apply for previous frame memory...\r\n");
+            close_out(EXIT_FAILURE);
+        }
+    }
+    
     Debug("NewImage:BlackImage and RedImage\r\n");
     Paint_NewImage(BlackImage, EPD_WIDTH, EPD_HEIGHT, 0, WHITE);
     Paint_NewImage(RedImage, EPD_WIDTH, EPD_HEIGHT, 0, WHITE);
@@ -195,6 +455,51 @@ void image_init()
     reset_image();
 }
 
+/**
+ * @brief : keep the images as previous frame (-u)
+ */
+void keep_frame()
+{
+    if (Prev_Black == NULL) return;
+    
+    memcpy(Prev_Black, BlackImage, EPD_PLANE_BYTES);
+    memcpy(Prev_Red, RedImage, EPD_PLANE_BYTES);
+    Prev_Valid = true;
+}
+
+/**
+ * @brief : set the way to wait for a busy display
+ * 
+ * @param p : mode[:poll[:timeout]] 
+ *  mode    : s = spin, p = poll, e = edge
+ *  poll    : poll interval in ms
+ *  timeout : timeout in ms (0 = no timeout)
+ */
+void set_wait_mode(char *p)
+{
+    EPD_WAIT_MODE mode;
+    unsigned int poll_ms = EPD_WAIT_POLL_DFT;
+    unsigned int timeout_ms = EPD_WAIT_TIMEOUT_DFT;
+    
+    if (*p == 's' || *p == 'S')      mode = EPD_WAIT_SPIN;
+    else if (*p == 'p' || *p == 'P') mode = EPD_WAIT_POLL;
+    else if (*p == 'e' || *p == 'E') mode = EPD_WAIT_EDGE;
+    else {
+        p_printf(D_RED, "Invalid wait mode %c\n", *p);
+        close_out(EXIT_FAILURE);
+    }
+    
+    if (*++p == ':') {
+        poll_ms = (unsigned int) strtod(++p, &p);
+        
+        if (*p == ':') timeout_ms = (unsigned int) strtod(++p, NULL);
+    }
+    
+    Debug("wait mode %d, poll %d ms, timeout %d ms\n", mode, poll_ms, timeout_ms);
+    
+    EPD_SetWaitMode(mode, poll_ms, timeout_ms);
+}
+
 /**
  * @brief signal handler
  */
@@ -216,22 +521,41 @@ void usage()
     "-P             read \"Formatted instructions\" from pipe\n"
     "   -r pipename read from named pipe (default %s)\n"
     "   -w pipename write to named pipe  (default %s)\n"
+    "-S socket      read \"Formatted instructions\" from unix socket (max %d clients)\n"
+    "-A             (with -P or -S) draw while the display refreshes\n"
+    "-L             (with -A) display only the latest frame drawn while the display refreshes\n"
+    "-i seconds     (with -P or -S) keep the display awake after a request (default 0)\n"
     "-T \"Formatted instructions\"  to display on epaper\n"
-    "-D             show debug information\n\n"
+    "-t name:file   read template name from file (see below)\n"
+    "-D             show debug information\n"
+    "-u             update only the changed area of the display\n"
+    "-f directory   directory with binary font files (default %s)\n"
+    "-E name[:file] write font as binary font file (default name%s)\n"
+    "-b name[:opt]  hardware backend: bcm2835 (default), linux or sim\n"
+    "               linux:opt = spidev device (default %s)\n"
+    "               sim:opt   = write the displayed frame as PPM file\n"
+    "-W m[:p[:t]]   wait for busy display: m = s(pin), p(oll) or e(dge, default)\n"
+    "               p = poll interval in ms (default %d)\n"
+    "               t = timeout in ms, 0 = no timeout (default %d)\n\n"
     "Formatted instructions :\n"
     " <         start of instructions (always first character)\n\n"
     "       ---------  format options ----------\n"
     " d=#,      set foreground color : # = B(black), W(white) or C(color)\n"
     " b=#,      set background color : # = B(black), W(white) or C(color)\n"
     " B=#,      set Border color     : # = B(black), W(white) or C(color)\n"
-    " f='#',    set font to use (# = name font as in Font-directory)\n"
+    " f='#',    set font to use (# = name of the font or #.epf file, e.g. font12)\n"
     " p=x:y,    set start position to display\n"
     " r=#,      rotate display 0, 90, 270,360\n"
     " m=#,      mirror image\n"
     "           # = N MIRROR_NONE\n"
     "           # = H MIRROR_HORIZONTAL\n"
     "           # = V MIRROR_VERTICAL\n"
-    "           # = O MIRROR_ORIGIN\n\n"
+    "           # = O MIRROR_ORIGIN\n"
+    " o=#,      image colors (i=)\n"
+    "           # = N black and white (default)\n"
+    "           # = C nearest of black, white and red\n"
+    "           # = F dithered black, white and red (Floyd-Steinberg)\n"
+    "           # = O dithered black, white and red (ordered)\n\n"
     "       ---------  display options ----------\n"
     " T=#,      display time (# = s (include seconds), n = (not include)\n"
     " D=#,      display date (# = n (as numbers) or w (as words)\n"
@@ -241,7 +565,9 @@ void usage()
     " q=X:Y:s,  draw empty rectangle X end, Y end, s = pixel size: 1 - 8\n"
     " Q=X:Y:s,  draw filled rectangle X end, Y end, s = pixel size: 1 - 8\n"
     " l=X:Y:Z:s,        drawline X end, Y end, Z = style, s = size: 1 - 8\n"
-    " i='filename',     load image (BMP) on current position\n"
+    " i='filename',     load image (BMP 1, 4, 8 or 24 bit) on current position\n"
+    " I='filename',     load frame file (full display, written with W=)\n"
+    " W='filename',     write the current images as frame file\n"
     " t='text',         display text\n"
     " n='Number',       display number\n\n"
 
@@ -253,61 +579,277 @@ void usage()
     "           # = r   restore the saved X / Y positions\n"
     "           # = p   set screen to deepsleep\n"
     "           # = i   initialise screen\n\n"
-    " >    end of instructions (ALWAYS)\n", VERSION,name_pipe_r,name_pipe_w);
+    " >    end of instructions (ALWAYS)\n\n"
+    "In a template (-t or <<TEMPLATE name>> on the pipe) numbers and text can be\n"
+    "a variable {name}. <<RENDER name var=value;var=value>> on the pipe draws it.\n", VERSION,name_pipe_r,name_pipe_w,
+    MAXCLIENTS,
+    FONT_DIR_DFT, FONT_EXT,
+    DEV_SPIDEV, EPD_WAIT_POLL_DFT, EPD_WAIT_TIMEOUT_DFT);
+}
+
+/**
+ *  @brief : get a template variable
+ *
+ *  @param p : points to {name}
+ *  @param var : receives the variable number + 1
+ *
+ *  @return :
+ *  OK = pointer after the }
+ *  Error = NULL
+ */
+char *get_variable(char *p, UBYTE *var)
+{
+    char *name = ++p;
+    int i;
+
+    while (isalnum((unsigned char) *p) || *p == '_') p++;
+
+    if (*p != '}' || p == name || p - name >= TPL_NAME) {
+        p_printf(RED,"invalid template variable %.*s\n", (int) (p - name), name);
+        return(NULL);
+    }
+
+    // known already ?
+    for (i = 0; i < DL_Template->Vars; i++)
+        if (strncmp(DL_Template->Var[i], name, p - name) == 0 &&
+            DL_Template->Var[i][p - name] == 0x0) break;
+
+    if (i == TPL_VARS) {
+        p_printf(RED,"too many template variables\n");
+        return(NULL);
+    }
+
+    if (i == DL_Template->Vars) {
+        sprintf(DL_Template->Var[i], "%.*s", (int) (p - name), name);
+        DL_Template->Vars++;
+    }
+
+    *var = i + 1;
+
+    return(++p);
+}
+
+/**
+ *  @brief : replace the {name} variables in text of a template
+ *
+ *  A variable is stored as DL_VAR followed by the variable number + 1
+ *  and filled in when the text is drawn (see get_text_value()).
+ *
+ *  @return :
+ *  OK = number of variables in the text
+ *  Error = -1
+ */
+int set_text_variables(char *s)
+{
+    char *d = s, *p;
+    UBYTE var;
+    int n = 0;
+
+    // DL_VAR marks a variable, it can not be part of a text
+    if (strchr(s, DL_VAR) != NULL) {
+        p_printf(RED,"invalid character 0x%02x in text\n", DL_VAR);
+        return(-1);
+    }
+
+    if (DL_Template == NULL) return(0);
+
+    while (*s != 0x0) {
+
+        if (*s == '{') {
+            if ((p = get_variable(s, &var)) == NULL) return(-1);
+            *d++ = DL_VAR;
+            *d++ = var;
+            s = p;
+            n++;
+        }
+        else
+            *d++ = *s++;
+    }
+
+    *d = 0x0;
+
+    return(n);
+}
+
+/**
+ *  @brief : get a number from the instruction
+ *
+ *  In a template the number can be a variable {name}.
+ *
+ *  @param p : points to the number
+ *  @param stop : characters that end the number
+ *  @param op : receives the number in op->Value[n] (or op->Var[n])
+ *  @param what : used in error messages
+ *
+ *  @return :
+ *  OK = pointer to the character that ended the number
+ *  Error = NULL
+ */
+char *get_value(char *p, char *stop, DL_OP *op, int n, char *what)
+{
+    char buf[7];
+    int i = 0;
+
+    if (*p == '{' && DL_Template != NULL)
+        return(get_variable(p, &op->Var[n]));
+
+    while (*p != 0x0 && strchr(stop, *p) == NULL) {
+
+        if (i == sizeof(buf) - 1) {
+            p_printf(RED,"%s too long\n", what);
+            return(NULL);
+        }
+
+        buf[i++] = *p++;
+    }
+
+    buf[i] = 0x0;
+    op->Value[n] = (UWORD) strtod(buf, NULL);
+
+    return(p);
+}
+
+/**
+ *  @brief : get a number followed by a ':'
+ *
+ *  @return :
+ *  OK = pointer after the ':'
+ *  Error = NULL
+ */
+char *get_field(char *p, DL_OP *op, int n, char *what)
+{
+    if ((p = get_value(p, ":", op, n, what)) == NULL) return(NULL);
+
+    if (*p != ':') {
+        p_printf(RED,"%s : expected ':'\n", what);
+        return(NULL);
+    }
+
+    return(++p);
+}
+
+/**
+ *  @brief : check the pixel size (1 - 8)
+ *
+ *  @return : true if invalid
+ */
+bool bad_pixel(UWORD value)
+{
+    if (value < DOT_PIXEL_1X1 || value > DOT_PIXEL_8X8) {
+        p_printf(RED,"In valid Pixel %d\n", value);
+        return(true);
+    }
+
+    return(false);
+}
+
+/**
+ *  @brief : check the rotation (0, 90, 180, 270)
+ *
+ *  @return : true if invalid
+ */
+bool bad_rotation(UWORD value)
+{
+    if (value != ROTATE_0 && value != ROTATE_90 &&
+        value != ROTATE_180 && value != ROTATE_270) {
+        p_printf(RED,"invalid rotation %d\n", value);
+        return(true);
+    }
+
+    return(false);
+}
+
+/**
+ *  @brief : get the pixel size (1 - 8), last field of an instruction
+ *
+ *  @return :
+ *  OK = pointer after the pixel size
+ *  Error = NULL
+ */
+char *get_pixel(char *p, DL_OP *op, int n, char *what)
+{
+    if ((p = get_value(p, ">,", op, n, what)) == NULL) return(NULL);
+
+    // a variable is checked when drawn
+    if (op->Var[n] == 0 && bad_pixel(op->Value[n])) return(NULL);
+
+    return(p);
 }
 
 /**
- *  @brief : set and check for font
+ *  @brief : get the font
  * 
- *  @param p : points to filename like 'font12' 
+ *  @param p : points to font name like 'font12' 
+ *  @param op : receives the font
  * 
  *  @return :
  *  OK = pointer after last  quote
  *  Error = NULL
  */
-char *set_font(char *p)
+char *get_font(char *p, DL_OP *op)
 {
-    char buf[25];
+    char name[FONT_NAME_MAX];
     int  i = 0;
-    FILE *fp;
     
     if (*p++ != '\'') {
         p_printf(D_RED,"Error during setting font. Expected ' but got %c\n", *--p);
         return(NULL);
     }
 
-    // get font filename (terminated wiht ' or >)
-    while(*p != '\'' && *p != '>' && i < FONTLENGTH)
-        IM_prop.font[i++] = *p++;
-    
-    IM_prop.font[i] = 0x0;
-    
-    // add font location
-    sprintf(buf,"%s%s.c", FONTLOCATION, IM_prop.font);
-       
-    // check that font file exists
-    if ( ! (fp=fopen(buf,"r")) ) {
+    // get font name (terminated wiht ' or >)
+    while(*p != '\'' && *p != '>' && *p != 0x0) {
         
-        // in case font (lower case) instead of Font (upper case)
-        if (IM_prop.font[0] > 'Z'){
-            
-            IM_prop.font[0] -= 0x20;
-            
-            // add font location
-            sprintf(buf,"%s%s.c", FONTLOCATION, IM_prop.font);
-            
-            if (!(fp = fopen(buf,"r")) ) { 
-                printf("can not find font %s", buf);
-                return(NULL);
-            }
+        if (i == FONT_NAME_MAX - 1) {
+            p_printf(D_RED,"Error during setting font. Name is too long\n");
+            return(NULL);
         }
+        
+        name[i++] = *p++;
     }
     
-    Debug("Set font to: %s\n",IM_prop.font);
+    name[i] = 0x0;
     
-    fclose(fp);
+    // resolve once, not each time text is drawn
+    if ((op->Font = Font_Find(name)) == NULL) {
+        p_printf(D_RED,"can not find font %s\n", name);
+        return(NULL);
+    }
     
-    return(++p);
+    if (*p == '\'') p++;
+    
+    return(p);
+}
+
+/**
+ *  @brief : write a font as binary font file
+ * 
+ *  @param p : font name, optional followed by :filename
+ * 
+ *  @return :
+ *  OK = 0
+ *  Error = -1
+ */
+int export_font(char *p)
+{
+    char file[MAXFILENAME + sizeof(FONT_EXT)];
+    char *name = p, *f = strchr(p, ':');
+    const FONT_ENTRY *font;
+    
+    if (f != NULL) *f++ = 0x0;
+    
+    if ((font = Font_Find(name)) == NULL) {
+        p_printf(D_RED,"can not find font %s\n", name);
+        return(-1);
+    }
+    
+    // default filename is the font name
+    if (f == NULL || *f == 0x0) sprintf(file, "%.*s%s", MAXFILENAME, font->Name, FONT_EXT);
+    else sprintf(file, "%.*s", MAXFILENAME, f);
+    
+    if (Font_Save(font, file)) return(-1);
+    
+    printf("font %s written to %s\n", font->Name, file);
+    return(0);
 }
 
 /**
@@ -320,26 +862,10 @@ char *set_font(char *p)
  * o = OK
  * -1 = error
  */ 
-int display_add_font(char * buf, bool number)  
+int display_add_font(const char * buf, bool number)
 {  
-    sFONT * tfont = 0 ;
-    cFONT * tcfont = 0;
-    
-    // select font depending of IM_prop.font
-    // if you add more fonts, store in the FONTLOCATION
-    // update Font.h
-    // update code below
-    if (strcasecmp(IM_prop.font,"Font8") == 0) tfont = &Font8;
-    else if (strcasecmp(IM_prop.font,"Font12") == 0) tfont = &Font12;
-    else if (strcasecmp(IM_prop.font,"Font12CN") == 0) tcfont = &Font12CN;
-    else if (strcasecmp(IM_prop.font,"Font16") == 0) tfont = &Font16;
-    else if (strcasecmp(IM_prop.font,"Font20") == 0) tfont = &Font20;
-    else if (strcasecmp(IM_prop.font,"Font24") == 0) tfont = &Font24;
-    else if (strcasecmp(IM_prop.font,"Font24CN") == 0) tcfont = &Font24CN;
-    else {
-        printf("Could not determine %s\n", IM_prop.font);
-        return(-1);
-    }
+    sFONT * tfont = IM_prop.font->Font;
+    cFONT * tcfont = IM_prop.font->FontCN;
     
     if (tfont != 0){
         
@@ -361,28 +887,28 @@ int display_add_font(char * buf, bool number)
 }        
 
 /**
- * @brief : displays text or a number on the screen
+ * @brief : get text or a number between quotes
  * 
  * @param p : pointer to 'text' or 'number'
- * @param number : true display number else text
+ * @param buf : receives the text (MAXTEXTLENGTH)
  * 
  * @return
- * pointer after the closing '
+ * OK = pointer after the closing '
+ * Error = NULL
  */
-char *display_txt(char *p, bool number)
+char *get_text(char *p, char *buf)
 {
-    char buf[MAXTEXTLENGTH];
     int  i = 0;
     bool escape = false;
 
     // check for ' start of text
     if (*p++ != '\'') {
         printf("error during display text, expect '. got %c \n", *--p);
-        exit(EXIT_FAILURE);
+        return(NULL);
     } 
     
     // get text between quotes
-    while(i < MAXTEXTLENGTH) {
+    while(*p != 0x0) {
     
         /* escape character do not store */
         if (*p == '\\' && ! escape) {
@@ -394,77 +920,54 @@ char *display_txt(char *p, bool number)
         /* if end character, but NOT escape we are done */
         if (*p == '\'' && ! escape) break;
         
+        if (i == MAXTEXTLENGTH - 1) {
+            p_printf(RED,"text too long\n");
+            return(NULL);
+        }
+
         /* store received character */
         buf[i++] = *p++;
         escape = false;
     }
     
+    if (*p != '\'') {
+        printf("error during display text, missing closing '\n");
+        return(NULL);
+    }
+
     buf[i] = 0x0;
-   
-    // display text or number with selected font
-    if (display_add_font(buf,number) == -1) return(NULL);
     
     return(++p);
 }
 
 /**
- * @brief set position to display next item
+ * @brief get position to display next item
  * @param p : pointer to xx:yy
  * 
  * @return :
  * pointer after last y
  */ 
-
-char *set_position(char *p)
+char *get_position(char *p, DL_OP *op)
 {
-    char buf[5];
-    int i = 0;
-    
-    while (*p != ':'){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"X position to long\n");
-            return(NULL);
-         }
-    }
-    
-    buf[i] = 0x0;
-    IM_prop.Xstart = (UWORD) strtod(buf, NULL);
-    p++; // skip :
-
-    i = 0;
-    while (*p != '>' && *p != ','){
-
-         buf[i++] = *p++;
+    if ((p = get_field(p, op, 0, "X position")) == NULL) return(NULL);
 
-         if (i > sizeof(buf)){
-            p_printf(RED,"Y postion too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    IM_prop.Ystart= (UWORD) strtod(buf, NULL);
-
-    return(p);
+    return(get_value(p, ">,", op, 1, "Y position"));
 }
 
 /** 
  * @brief Color
  * 
- * @param col : color to set (background/foreground)
+ * @param op :  receives the color to set (background/foreground)
  * @param p :   pointer to color (BWC)
  * 
  * @return
  * Pointer AFTER color
  */
-char * set_color(UWORD *col, char *p)
+char * get_color(char *p, DL_OP *op)
 {
-    if (*p == 'B' || *p == 'b' )     *col = BLACK;
-    else if (*p == 'W'|| *p == 'w' ) *col = WHITE;
-    else if (*p == 'C' || *p == 'c') *col = COLOR;
+    if (*p == 'B' || *p == 'b' )     op->Value[0] = BLACK;
+    else if (*p == 'W'|| *p == 'w' ) op->Value[0] = WHITE;
+    else if (*p == 'C' || *p == 'c') op->Value[0] = COLOR;
     else {
         printf("Invalid color %c\n", *p);
         return(NULL);
@@ -474,7 +977,30 @@ char * set_color(UWORD *col, char *p)
 } 
 
 /**
- * @brief set display flip 
+ * @brief : get how images are turned into panel colors
+ * 
+ * @param p : pointer to N, C, F or O
+ * 
+ *  @return :
+ *  OK = pointer after the option
+ *  Error = NULL
+ */
+char *get_dither(char *p, DL_OP *op)
+{
+    if (*p == 'N'|| *p == 'n')      op->Value[0] = DITHER_NONE;
+    else if (*p == 'C'|| *p == 'c') op->Value[0] = DITHER_NEAREST;
+    else if (*p == 'F'|| *p == 'f') op->Value[0] = DITHER_FLOYD;
+    else if (*p == 'O'|| *p == 'o') op->Value[0] = DITHER_ORDERED;
+    else {
+        printf("invalid image colors %c\n", *p);
+        return(NULL);
+    }
+    
+    return(++p);
+}
+
+/**
+ * @brief get display flip
  * @param p : pointer instruction
  * N = MIRROR_NONE 
  * H = MIRROR_HORIZONTAL
@@ -483,26 +1009,22 @@ char * set_color(UWORD *col, char *p)
  * 
  * @return : pointer after instruction
  */
-char *set_mirror(char *p)
+char *get_mirror(char *p, DL_OP *op)
 {
-    UBYTE mirror;
-    
-    if (*p == 'N'|| *p == 'n')      mirror = MIRROR_NONE;
-    else if (*p == 'H'|| *p == 'h') mirror = MIRROR_HORIZONTAL;
-    else if (*p == 'V'|| *p == 'v') mirror = MIRROR_VERTICAL;
-    else if (*p == 'O'|| *p == 'o') mirror = MIRROR_ORIGIN;
+    if (*p == 'N'|| *p == 'n')      op->Value[0] = MIRROR_NONE;
+    else if (*p == 'H'|| *p == 'h') op->Value[0] = MIRROR_HORIZONTAL;
+    else if (*p == 'V'|| *p == 'v') op->Value[0] = MIRROR_VERTICAL;
+    else if (*p == 'O'|| *p == 'o') op->Value[0] = MIRROR_ORIGIN;
     else {
         printf("invalid mirror %c\n", *p);
         return(NULL);
     }
  
-    Paint_SetMirroring(mirror);
-    
     return(++p);
 }  
 
 /**
- * @brief : set display rotation
+ * @brief : get display rotation
  * @param p
  * 0    ROTATE_0 
  * 90   ROTATE_90
@@ -511,38 +1033,34 @@ char *set_mirror(char *p)
  * 
  * @return : pointer after rotation instruction
  */
-char *set_rotation(char *p)
+char *get_rotation(char *p, DL_OP *op)
 {
-    char buf[5];
-    int i = 0;
-    UWORD Rotate;
-    
-    while (*p != 0x0 && *p != ',' && *p != '>' ){
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"Rotation too long %s\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    i = (int) strtod(buf, NULL);
-    
-    if(i == 0)        Rotate = ROTATE_0;
-    else if(i == 90)  Rotate = ROTATE_90;
-    else if(i == 180) Rotate = ROTATE_180;
-    else if(i == 270) Rotate = ROTATE_270;
+    if ((p = get_value(p, ">,", op, 0, "Rotation")) == NULL) return(NULL);
 
-    Paint_SetRotate(Rotate);
+    // a variable is checked when set
+    if (op->Var[0] == 0 && bad_rotation(op->Value[0])) return(NULL);
 
     return(p);
 }
 
+/**
+ * @brief : the display did not get ready in time (busy timeout)
+ *
+ * It is unknown what the panel shows. The next frame is sent complete,
+ * after a reset and init of the display.
+ *
+ * @return : -1
+ */
+int display_failed()
+{
+    EPD_PanelValid = false;
+    EPD_Awake = false;
+    return(-1);
+}
+
 /**
  * @brief : perform special instruction
- * @param p:
+ * @param c:
  * 
  * C/c clear screen
  * D/d display current X and Y positions
@@ -550,21 +1068,35 @@ char *set_rotation(char *p)
  * R/r restore saved X and Y positions
  * P/p pauze screen power (deelsleep)
  * I/i initialize screen (wake from deepsleep)
- * 
- * @return : pointer after instruction
+ *
+ * @return : -1 on display busy timeout, else 0
  */
-char * special_instruction(char *p)
+int special_instruction(char c)
 {
-    char c = *p;
-
     switch (c) {
         
         case 'C':   // perform complete clear
             Debug("clear...\r\n");
+            panel_wait();
+            if (! EPD_Awake) hw_init();
             EPD_DisplayOn = true;
-            EPD_Clear();
+            if (EPD_Clear()) {
+                display_failed();
+                panel_done();
+                return(-1);
+            }
             DEV_Delay_ms(500); 
-            // fall through
+            panel_done();
+            reset_image();
+            init_variables();
+            
+            // images and panel are both white now
+            Paint_ClearDirty();
+            keep_frame();
+            EPD_PanelHash = EPD_FrameHash(BlackImage, RedImage);
+            EPD_PanelValid = true;
+            break;
+            
         case 'c':   
             reset_image();
             init_variables();
@@ -593,21 +1125,25 @@ char * special_instruction(char *p)
    
         case 'P':
         case 'p': // set screeen in deepsleep
-            if (EPD_DisplayOn) EPD_Sleep();
-            EPD_DisplayOn = false;
+            panel_wait();
+            panel_sleep();
+            panel_done();
             break;
  
         case 'I':
         case 'i': // start screeen from deepsleep
-            EPD_Init();
+            panel_wait();
+            hw_init();
+            panel_done();
             break;
             
     }
-    return(++p);
+
+    return(0);
 }
 
 /**
- * @brief display a line on th epaper
+ * @brief get a line
  * 
  * l=X:Y;Z:s   
  * X position end of line, 
@@ -617,327 +1153,51 @@ char * special_instruction(char *p)
  * 
  * @return : pointer after instruction
  */
-char *display_line(char *p)
+char *get_line(char *p, DL_OP *op)
 {
-    UWORD Xend, Yend;
-    LINE_STYLE Line_Style; 
-    DOT_PIXEL Dot_Pixel = DOT_PIXEL_DFT;
-    char buf[5];
-    int i = 0;
-    
-    while (*p != ':'){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"line Xend position to long\n");
-            return(NULL);
-         }
-    }
-    
-    buf[i] = 0x0;
-    Xend = (UWORD)strtod(buf, NULL);
-    p++; // skip :
-
-    i = 0;
-    while (*p != ':') {
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"line Yend postion too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    Yend= (UWORD)strtod(buf, NULL);
-
-    p++; // skip :
-    i = 0;
-    
-    while (*p != ':') {
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"line style too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    if (strtod(buf, NULL) > 0) Line_Style = LINE_STYLE_DOTTED;
-    else Line_Style = LINE_STYLE_SOLID;
-    
-    // get pixel size
-    p++; // skip :
-    i = 0;
-    while (*p != '>' && *p != ','){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"line pixel too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    i = (int) strtod(buf, NULL);
-    
-    switch (i) {
-        case 1 : Dot_Pixel = DOT_PIXEL_1X1; break;
-        case 2 : Dot_Pixel = DOT_PIXEL_2X2; break;
-        case 3 : Dot_Pixel = DOT_PIXEL_3X3; break;
-        case 4 : Dot_Pixel = DOT_PIXEL_4X4; break;
-        case 5 : Dot_Pixel = DOT_PIXEL_5X5; break;
-        case 6 : Dot_Pixel = DOT_PIXEL_6X6; break;
-        case 7 : Dot_Pixel = DOT_PIXEL_7X7; break;
-        case 8 : Dot_Pixel = DOT_PIXEL_8X8; break;
-        default :
-                p_printf(RED,"In valid Pixel %d\n", i);
-                return(NULL);
-                break;
-    }
-    
-    Paint_SelectImage(BlackImage);
-    ePaint_DrawLine(IM_prop.Xstart, IM_prop.Ystart, Xend, Yend, IM_prop.front_color, Line_Style, Dot_Pixel);
+    if ((p = get_field(p, op, 0, "line Xend position")) == NULL) return(NULL);
+    if ((p = get_field(p, op, 1, "line Yend position")) == NULL) return(NULL);
+    if ((p = get_field(p, op, 2, "line style")) == NULL) return(NULL);
 
-    // set the new X and Y positions.
-    IM_prop.Xstart = Xend + 1;
-    IM_prop.Ystart = Yend;
-    
-    return(++p);
+    return(get_pixel(p, op, 3, "line pixel"));
 }
 
 /**
- * @brief Display a point
- * P=s    draw a point s = size
- */
-char *display_point(char *p)
-{
-    DOT_PIXEL Dot_Pixel = DOT_PIXEL_DFT;
-    char buf[5];
-    int i = 0;
-    
-    i = 0;
-    
-    while (*p != '>' && *p != ','){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"Point pixel too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    i = (int) strtod(buf, NULL);
-    
-    switch (i) {
-        case 1 : Dot_Pixel = DOT_PIXEL_1X1; break;
-        case 2 : Dot_Pixel = DOT_PIXEL_2X2; break;
-        case 3 : Dot_Pixel = DOT_PIXEL_3X3; break;
-        case 4 : Dot_Pixel = DOT_PIXEL_4X4; break;
-        case 5 : Dot_Pixel = DOT_PIXEL_5X5; break;
-        case 6 : Dot_Pixel = DOT_PIXEL_6X6; break;
-        case 7 : Dot_Pixel = DOT_PIXEL_7X7; break;
-        case 8 : Dot_Pixel = DOT_PIXEL_8X8; break;
-        default :
-                p_printf(RED,"In valid point size %d\n", i);
-                return(NULL);
-                break;
-    }
-    
-    // support colors
-    if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
-        
-    Paint_DrawPoint(IM_prop.Xstart, IM_prop.Ystart, BLACK, Dot_Pixel, DOT_STYLE_DFT);
-    
-    Paint_SelectImage(BlackImage);
-    
-    // set next start position after POINT
-    IM_prop.Xstart += (UWORD) i;
-    
-    return(++p);
-}
-
-/** 
- * @brief display circle
+ * @brief get a circle
  * 
  * c or C = R:s
  * R = radius
  * s = size of pixel
  */
-char *display_circle(char *p, bool filled)
+char *get_circle(char *p, DL_OP *op)
 {
-    char buf[7];
-    int i = 0;
-    UWORD radius;
-    DOT_PIXEL Dot_Pixel = DOT_PIXEL_DFT;
-    
-    // get radius
-    while (*p != ':') {
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf) -1){
-            p_printf(RED,"Circle Radius too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    radius = (UWORD)strtod(buf, NULL);
-    
-    // get pixel size
-    p++; // skip :
-    i = 0;
-    while (*p != '>' && *p != ','){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"circle pixel too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    i = (int) strtod(buf, NULL);
-    
-    switch (i) {
-        case 1 : Dot_Pixel = DOT_PIXEL_1X1; break;
-        case 2 : Dot_Pixel = DOT_PIXEL_2X2; break;
-        case 3 : Dot_Pixel = DOT_PIXEL_3X3; break;
-        case 4 : Dot_Pixel = DOT_PIXEL_4X4; break;
-        case 5 : Dot_Pixel = DOT_PIXEL_5X5; break;
-        case 6 : Dot_Pixel = DOT_PIXEL_6X6; break;
-        case 7 : Dot_Pixel = DOT_PIXEL_7X7; break;
-        case 8 : Dot_Pixel = DOT_PIXEL_8X8; break;
-        default :
-            p_printf(RED,"In valid Pixel %d\n", i);
-            return(NULL);
-            break;
-    }
-    
-    // support colors
-    if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
-    else Paint_SelectImage(BlackImage);
-    
-    if (filled)
-        Paint_DrawCircle(IM_prop.Xstart, IM_prop.Ystart, radius, BLACK, DRAW_FILL_FULL, Dot_Pixel);
-    else
-        Paint_DrawCircle(IM_prop.Xstart, IM_prop.Ystart, radius, BLACK, DRAW_FILL_EMPTY, Dot_Pixel);
+    if ((p = get_field(p, op, 0, "Circle Radius")) == NULL) return(NULL);
 
-    Paint_SelectImage(BlackImage);
-    
-    return(++p);    
+    return(get_pixel(p, op, 1, "circle pixel"));
 }
 
 /** 
- * @brief display rectangle
+ * @brief get a rectangle
  * 
  *  q or Q=X:Y:s draw filled rectangle X end, Y end, s = pixel size
  */
-char * display_rectangle(char *p,bool filled)
+char * get_rectangle(char *p, DL_OP *op)
 {
-    char buf[7];
-    int i = 0;
-    UWORD Xend, Yend;
-    DOT_PIXEL Dot_Pixel = DOT_PIXEL_DFT;
-    
-    // get Xend
-    while (*p != ':'){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"rectangle Xend position to long\n");
-            return(NULL);
-         }
-    }
-    
-    buf[i] = 0x0;
-    Xend = (UWORD)strtod(buf, NULL);
-    p++; // skip :
-
-    i = 0;
-    while (*p != ':') {
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"rectangle Yend postion too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    Yend= (UWORD)strtod(buf, NULL);
-
-    // get pixel size
-    p++; // skip :
-    i = 0;
-    while (*p != '>' && *p != ','){
-
-         buf[i++] = *p++;
-
-         if (i > sizeof(buf)){
-            p_printf(RED,"rectangle pixel too long\n");
-            return(NULL);
-         }
-    }
-
-    buf[i] = 0x0;
-    
-    i = (int) strtod(buf, NULL);
-    
-    switch (i) {
-        case 1 : Dot_Pixel = DOT_PIXEL_1X1; break;
-        case 2 : Dot_Pixel = DOT_PIXEL_2X2; break;
-        case 3 : Dot_Pixel = DOT_PIXEL_3X3; break;
-        case 4 : Dot_Pixel = DOT_PIXEL_4X4; break;
-        case 5 : Dot_Pixel = DOT_PIXEL_5X5; break;
-        case 6 : Dot_Pixel = DOT_PIXEL_6X6; break;
-        case 7 : Dot_Pixel = DOT_PIXEL_7X7; break;
-        case 8 : Dot_Pixel = DOT_PIXEL_8X8; break;
-        default :
-            p_printf(RED,"In valid Pixel %d\n", i);
-            return(NULL);
-            break;
-    }
-    
-    // support colors
-    if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
-    else Paint_SelectImage(BlackImage);
-    
-    if (filled)
-        Paint_DrawRectangle(IM_prop.Xstart, IM_prop.Ystart, Xend, Yend, BLACK, DRAW_FILL_FULL, Dot_Pixel);
-     else
-        Paint_DrawRectangle(IM_prop.Xstart, IM_prop.Ystart, Xend, Yend, BLACK, DRAW_FILL_EMPTY, Dot_Pixel);
+    if ((p = get_field(p, op, 0, "rectangle Xend position")) == NULL) return(NULL);
+    if ((p = get_field(p, op, 1, "rectangle Yend position")) == NULL) return(NULL);
 
-    Paint_SelectImage(BlackImage);
-    
-    return(++p);    
+    return(get_pixel(p, op, 2, "rectangle pixel"));
 }
 
 /**
  *  @brief : display time or date info
- *  @param p : 
+ *  @param option :
  *      n numeric date
  *      s add seconds to timestamp
  *  @param date : 
  *      true :add date to timestamp
  */
-
-char *display_time_day(char *p, bool date)
+int display_time_day(char option, bool date)
 {
     char buf[MAXTEXTLENGTH];
     
@@ -957,318 +1217,1103 @@ char *display_time_day(char *p, bool date)
     // if date is requested
     if (date){
         
-        if (*p == 'n' || *p == 'N' )     // display as number mm:dd:yy
+        if (option == 'n' || option == 'N' )     // display as number mm:dd:yy
             sprintf(buf, " %d-%d-%d ", tm->tm_mday, tm->tm_mon +1, 1900 + tm->tm_year);
         else
             sprintf(buf, "%.3s %3d %.3s %d ",wday_name[tm->tm_wday], tm->tm_mday,
                 mon_name[tm->tm_mon], 1900 + tm->tm_year);
     }
     else {
-        if (*p == 's' || *p == 'S')     // display as number HH:MM:SS
+        if (option == 's' || option == 'S')     // display as number HH:MM:SS
             sprintf(buf, "%.2d:%.2d:%.2d", tm->tm_hour, tm->tm_min, tm->tm_sec);
         else                            // display as number HH:MM
             sprintf(buf, "%.2d:%.2d", tm->tm_hour, tm->tm_min);
     }
     
     // display (not as number)
-    if (display_add_font(buf,false) == -1) return(NULL);
-    
-    return(++p);
+    return(display_add_font(buf,false));
 }
 
 /**
- * during EPD_init() EPD_SendCommand(VCOM_AND_DATA_INTERVAL_SETTING); 
- * the border is set as white
-
+ *  @brief : get a single character option (T=, D=, B= and !=)
+ *
+ *  @param valid : valid options, NULL is any
+ *
+ *  @return :
+ *  OK = pointer after the option
+ *  Error = NULL
  */
-char * set_border_color(char *p)
+char * get_option(char *p, DL_OP *op, char *valid)
 {
-    if (EPD_Set_Border(*p))
+    if (*p == 0x0 || (valid != NULL && strchr(valid, *p) == NULL))
     {
-        printf("Invalid color %c\n", *p);
+        printf("Invalid option %c\n", *p);
         return(NULL);
     }
+
+    op->Option = *p;
     
     return(++p);
 } 
 
 /**
- *  @brief : Display BMP file
+ *  @brief : get a filename between quotes
+ * 
+ *  @param p : points to 'filename'
+ *  @param buf : receives the filename (MAXFILENAME)
+ *  @param what : used in error messages
  * 
  *  @return :
- *  OK = pointer after last  quote
+ *  OK = pointer after the closing quote
  *  Error = NULL
  */
-char * display_BMP(char *p)
+char * get_filename(char *p, char *buf, char *what)
 {
-    char buf[MAXFILENAME];
     int i = 0;
  
-    // check for ' start of image name
+    // check for ' start of name
     if (*p++ != '\'') {
-        printf("error during obtaining BMP file, expect '. got %c \n", *--p);
+        printf("error during obtaining %s file, expect '. got %c \n", what, *--p);
         return(NULL);
     }     
 
-    // extract BMP filename
-    while (*p != '\'' && *p != '>' && *p != ',' ){
+    // extract filename
+    while (*p != '\'' && *p != '>' && *p != ',' && *p != 0x0){
          buf[i++] = *p++;
 
-         if (i > sizeof(buf)){
-            p_printf(RED,"BMP filename to long\n");
+         if (i == MAXFILENAME){
+            p_printf(RED,"%s filename to long\n", what);
             return(NULL);
          }
     }
     
-    buf[i] = 0x0;
-    
-    Debug("BMP-file to display: %s\n",buf);
-    
-    // 
-    if (GUI_ReadBmp(buf, IM_prop.Xstart, IM_prop.Ystart) == 1) {
-        p_printf(RED,"Could not handle BMP filename %s\n", buf);
+    if (*p != '\'') {
+        printf("error during obtaining %s file, missing closing '\n", what);
         return(NULL);
     }
 
+    buf[i] = 0x0;
+    
     return(++p);
 }
 
 /**
- * @brief parse formatted string
+ *  @brief : Display BMP file
  * 
- * <    start of instructions
- *  B=#     set border color (BWC)
+ *  @return :
+ *  OK = 0
+ *  Error = -1
+ */
+int display_BMP(const char *file)
+{
+    int i;
+ 
+    Debug("BMP-file to display: %s\n",file);
+    
+    if (IM_prop.dither == DITHER_NONE)
+        i = GUI_ReadBmp(file, IM_prop.Xstart, IM_prop.Ystart);
+    else
+        i = GUI_ReadBmpColor(file, IM_prop.Xstart, IM_prop.Ystart, BlackImage, RedImage, IM_prop.dither);
+    
+    if (i == 1) {
+        p_printf(RED,"Could not handle BMP filename %s\n", file);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ *  @brief : load the images from a frame file
  * 
- *  f=#     set font to use
- *  p=x:y   set start position to display
+ *  The frame file stays mapped, if nothing is drawn on top the frame
+ *  is sent to the display as stored in the file (see display_image())
  * 
- *  d=#     set foreground color (BWC)
- *  b=#     set background color (BWC)
+ *  @return :
+ *  OK = 0
+ *  Error = -1
+ */
+int load_frame(const char *file)
+{
+    Debug("frame file to display: %s\n",file);
+    
+    EPD_FrameClose(&Frame_File);
+    Frame_Pending = false;
+    
+    if (EPD_FrameOpen(file, &Frame_File)) {
+        p_printf(RED,"Could not handle frame file %s\n", file);
+        return(-1);
+    }
+    
+    Paint_ImageCopy(BlackImage, Frame_File.Black);
+    Paint_ImageCopy(RedImage, Frame_File.Red);
+    Frame_Pending = true;
+
+    return(0);
+}
+
+/**
+ *  @brief : write the images to a frame file
  * 
- *  i=''    load image on current position
- *  t=''    display text
- *  n=''    display number
+ *  @return :
+ *  OK = 0
+ *  Error = -1
+ */
+int save_frame(const char *file)
+{
+    if (EPD_FrameSave(file, BlackImage, RedImage)) {
+        p_printf(RED,"Could not write frame file %s\n", file);
+        return(-1);
+    }
+
+    return(0);
+}
+
+/**
+ * @brief : area of the images that differs from the previous frame (-u)
  * 
- *  l=X:Y;Z:s   drawline X end, Y end, Z = style, s = size
+ * Only the area that was drawn in is compared. An operation on the
+ * complete image (!=c, I=) marks everything, but can change little, e.g.
+ * a clock that is cleared and drawn again.
  * 
- *  m=#     mirror image (N,O,H,V)
+ * Without previous frame the area that was drawn in is used.
  * 
- *  P=s     draw a point s = size
+ * @param f : receives the area (in memory, after rotate and mirror)
  * 
- *  r=#     rotate 0,90,270, 360
+ * @return : true if the area is set, false if nothing changed
+ */
+bool frame_diff(DISPLAY_FRAME *f)
+{
+    UWORD Xstart, Ystart, Xend, Yend, x, y;
+    UDOUBLE o;
+    bool found = false;
+    
+    if (! Paint_GetDirty(&Xstart, &Ystart, &Xend, &Yend)) return(false);
+    
+    if (! Prev_Valid) {
+        f->Xstart = Xstart;
+        f->Ystart = Ystart;
+        f->Xend = Xend;
+        f->Yend = Yend;
+        return(true);
+    }
+    
+    // compare per byte (8 pixels)
+    for (y = Ystart; y <= Yend; y++) {
+        
+        o = (UDOUBLE) y * (EPD_WIDTH / 8);
+        
+        for (x = Xstart / 8; x <= Xend / 8; x++) {
+            
+            if (BlackImage[o + x] == Prev_Black[o + x] && RedImage[o + x] == Prev_Red[o + x])
+                continue;
+            
+            if (! found) {
+                f->Xstart = f->Xend = x;
+                f->Ystart = y;
+                found = true;
+            }
+            else if (x < f->Xstart) f->Xstart = x;
+            else if (x > f->Xend) f->Xend = x;
+            
+            f->Yend = y;
+        }
+    }
+    
+    f->Xstart *= 8;
+    f->Xend = f->Xend * 8 + 7;
+    
+    return(found);
+}
+
+/**
+ * @brief : take the images as frame to display
  * 
- *  c=r:s   draw empty circle R = radius pixelsize s
- *  C=r:s   draw filled circle R = radius pixelsize s
+ * The area that changed is reset, the next frame has the changes
+ * since this frame.
  * 
- *  q=X:Y:s draw empty rectangle X end, Y end, s = pixel size
- *  Q=X:Y:s draw filled rectangle X end, Y end, s = pixel size
+ * @param f : receives the frame (pointing to BlackImage and RedImage)
+ */
+void display_prepare(DISPLAY_FRAME *f)
+{
+    f->Black = BlackImage;
+    f->Red = RedImage;
+    f->Packed = NULL;
+    
+    // images as loaded from a frame file: hash and packed frame are known
+    if (Frame_Pending && memcmp(BlackImage, Frame_File.Black, EPD_PLANE_BYTES) == 0 &&
+        memcmp(RedImage, Frame_File.Red, EPD_PLANE_BYTES) == 0) {
+        f->Hash = Frame_File.Hash;
+        f->Packed = Frame_File.Packed;
+    }
+    else
+        f->Hash = EPD_FrameHash(BlackImage, RedImage);
+    
+    Frame_Pending = false;
+    
+    if (Partial_Update) {
+        f->Dirty = frame_diff(f);
+        keep_frame();
+    }
+    else
+        f->Dirty = Paint_GetDirty(&f->Xstart, &f->Ystart, &f->Xend, &f->Yend);
+    
+    Paint_ClearDirty();
+}
+
+/**
+ * @brief : send a frame to the display
  * 
- *  T=n or s display time (s means include seconds, n = not include)
- *  D=n or w display date as numbers(n) or words(w)
+ * Nothing is sent if the panel already shows the same images.
  * 
- *  !=      special instructions
- *      c   perform a clear screen
- *      d   display the current X / Y positions
- *      s   save the current X / Y positions
- *      r   restore the saved X / Y positions
- *      more here..............
+ * With partial update (-u) only the area that changed since the last
+ * display is sent and refreshed, if the panel shows the images already
+ * and the area is not too large. Else the complete images are sent.
  * 
- * >    end of instructions
+ * @return : 
+ * -1 : display busy timeout
+ *  0 : the panel shows the frame already
+ *  1 : the display was refreshed
+ */
+int display_frame(const DISPLAY_FRAME *f)
+{
+    UDOUBLE area;
+    const UBYTE *packed = f->Packed;
+    
+    if (EPD_PanelValid && f->Hash == EPD_PanelHash) {
+        Debug("frame already on display, no display update\n");
+        Frames_Skipped++;
+        return(0);
+    }
+    
+    Frames_Displayed++;
+    
+    if (Partial_Update && EPD_PanelValid && f->Dirty) {
+        
+        area = (UDOUBLE) (f->Xend - f->Xstart + 1) * (f->Yend - f->Ystart + 1);
+        
+        if (area * 100 < (UDOUBLE) EPD_WIDTH * EPD_HEIGHT * PARTIAL_MAX) {
+            if (EPD_DisplayPartial(f->Black, f->Red, f->Xstart, f->Ystart, f->Xend, f->Yend))
+                return(display_failed());
+
+            EPD_PanelHash = f->Hash;
+            return(1);
+        }
+    }
+    
+    // recently displayed images are packed already
+    if (packed == NULL) packed = EPD_PackedGet(f->Hash, f->Black, f->Red);
+    
+    if (packed ? EPD_DisplayPacked(packed) : EPD_Display(f->Black, f->Red))
+        return(display_failed());
+    
+    EPD_PanelHash = f->Hash;
+    EPD_PanelValid = true;
+    return(1);
+}
+
+/**
+ * @brief : send the images to the display
  * 
+ * @return : as display_frame()
+ */
+int display_image()
+{
+    DISPLAY_FRAME f;
+    
+    display_prepare(&f);
+    
+    return(display_frame(&f));
+}
+
+/**
+ * @brief : length of an instruction
+ *
+ * Up to and including the first '>' that is not between quotes. Text
+ * can contain a '>', the pipe does not end Instruction with 0x0.
+ *
+ * @param ins : instruction
+ */
+int instruction_length(const char *ins)
+{
+    int i;
+    bool quote = false;
+
+    for (i = 0; i < MAXINSTRUCTIONS - 1 && ins[i] != 0x0; i++) {
+
+        if (quote && ins[i] == '\\' && ins[i + 1] != 0x0) i++;
+        else if (ins[i] == '\'') quote = !quote;
+        else if (ins[i] == '>' && !quote) return(i + 1);
+    }
+
+    return(i);
+}
+
+/**
+ * @brief : compile an instruction into a display list
+ *
+ * All parsing, checking and font lookups are done here, once.
+ * run_display_list() only draws.
+ *
+ * @param src : instruction, ended with 0x0
+ * @param op : receives the ops (DL_OPS)
+ * @param pool : receives the text and filenames (as long as src)
+ * @param count : receives the number of ops
+ * @param display : receives whether the images are displayed after
+ *
  * @return
  * -2 : syntax error
- * -1 : error during execution
- * 
+ * -1 : error in an instruction
  *  0 : all good
- *  else offset to *P where end was found
  */
-int parse_string_instruction()
+int compile_instruction(char *src, DL_OP *op, char *pool, UWORD *count, bool *display)
 {
-   char c;
-   char *s, *p = Instruction;
-   bool turn_display_on = false;
-   
+    char c;
+    char *s, *p = src;
+    DL_OP *o;
+    int vars;
+
+    *count = 0;
+    *display = false;
+
     // check for start of instruction
     if (*p++ != '<') {
         p_printf(D_RED," missing start of instruction : '<' \n");
         return(-2);
     }
-    
+
     while (*p != '>' && *p != 0x0)
     {
         c = *p++;
-   
+
         // if space, CR, NL  or comma skip rest
         if (c == 0x20 || c== ',' || c == 0x0d || c== 0x0a) continue;
-        
+
         if (*p++ != '=') {
             p--;
             p_printf(D_RED, "Parseline : sequence error expected '=' got %c, 0x%x\n", *p, *p);
             printf("Parsed sofar :");
-            s=Instruction;
+            s=src;
             while ( p != s) printf("%c", *s++);
             printf("\n");
             return(-2);
         }
-        
+
+        if (*count == DL_OPS) {
+            p_printf(D_RED, "Too many instructions\n");
+            return(-2);
+        }
+
+        o = &op[(*count)++];
+        memset(o, 0x0, sizeof(DL_OP));
+        o->Code = c;
+
         switch(c) {
 
             case 'f':        // set font
-                    if ((p = set_font(p)) == NULL) return(-1);
+                    p = get_font(p, o);
                     break;
-            
+
             case 'p':       // set position
-                    if ((p = set_position(p)) == NULL) return(-1);
-                    break;
-                    
-            case 'd':       // set display / foreground color
-                    if ((p = set_color(&IM_prop.front_color,p)) == NULL) return(-1);
+                    p = get_position(p, o);
                     break;
 
+            case 'd':       // set display / foreground color
             case 'b':       // set background color
-                    if ((p = set_color(&IM_prop.back_color,p)) == NULL) return(-1);
+                    p = get_color(p, o);
                     break;
 
             case 'B':       // set border color
-                    if ((p = set_border_color(p)) == NULL) return(-1);
-                    turn_display_on = true;  
+                    p = get_option(p, o, "BbWwCc");
+                    *display = true;
                     break;
-                    
+
             case 'm':       // set image mirror
-                    if ((p = set_mirror(p)) == NULL) return(-1);
+                    p = get_mirror(p, o);
                     break;
-                    
+
             case 'r':       // set rotation
-                    if ((p = set_rotation(p)) == NULL) return(-1);
+                    p = get_rotation(p, o);
                     break;
-            
+
+            case 'o':       // set image colors
+                    p = get_dither(p, o);
+                    break;
+
             case '!':      // special instructions
-                    if ((p = special_instruction(p)) == NULL) return(-1);
+                    p = get_option(p, o, NULL);
                     break;
-                               
+
             case 'P':      // display point
-                    if ((p = display_point(p)) == NULL) return(-1);
-                    turn_display_on = true;
+                    p = get_pixel(p, o, 0, "Point pixel");
+                    *display = true;
                     break;
-                    
+
             case 'c':       // display OPEN circle
-                    if ((p = display_circle(p,false)) == NULL) return(-1);
-                    turn_display_on = true;
-                    break;
-                                      
             case 'C':       // display FILLED circle
-                    if ((p = display_circle(p,true)) == NULL) return(-1);
-                    turn_display_on = true;
-                    break;  
-                                            
-            case 'q':       // display OPEN rectangle
-                    if ((p = display_rectangle(p,false)) == NULL) return(-1);
-                    turn_display_on = true;
+                    p = get_circle(p, o);
+                    *display = true;
                     break;
-                                      
+
+            case 'q':       // display OPEN rectangle
             case 'Q':       // display FILLED rectangle
-                    if ((p = display_rectangle(p,true)) == NULL) return(-1);
-                    turn_display_on = true;
+                    p = get_rectangle(p, o);
+                    *display = true;
                     break;
-                    
+
             case 'i':       // display BMP image
-                    if((p = display_BMP(p)) == NULL) return(-1);
-                    turn_display_on = true;
+            case 'I':       // display frame file
+            case 'W':       // write frame file
+                    if ((p = get_filename(p, pool, c == 'i' ? "BMP" : "frame")) == NULL) return(-1);
+                    if ((vars = set_text_variables(pool)) < 0) return(-1);
+                    o->Text_Vars = vars > 0;
+                    o->Text = pool;
+                    pool += strlen(pool) + 1;
+                    if (c != 'W') *display = true;
                     break;
-                    
+
             case 'T':       // display time
-                    if ((p = display_time_day(p, false)) == NULL) return(-1);
-                    turn_display_on = true;
-                    break;
-                                      
             case 'D':       // display date
-                    if ((p = display_time_day(p, true)) == NULL) return(-1);
-                    turn_display_on = true;
+                    p = get_option(p, o, NULL);
+                    *display = true;
                     break;
-                    
+
             case 't':         // display text
-                    if ((p = display_txt(p, false)) == NULL) return(-1);
-                    turn_display_on = true;
+            case 'n':         // display number
+                    if ((p = get_text(p, pool)) == NULL) return(-1);
+                    if ((vars = set_text_variables(pool)) < 0) return(-1);
+                    o->Text_Vars = vars > 0;
+                    o->Text = pool;
+                    pool += strlen(pool) + 1;
+                    *display = true;
                     break;
 
             case 'l':          // draw line
-                    if ((p = display_line(p)) == NULL) return(-1);
-                    turn_display_on = true;
+                    p = get_line(p, o);
+                    *display = true;
                     break;
-                    
-            case 'n':         // display number 
-                    if ((p = display_txt(p, true)) == NULL) return(-1);  
-                    turn_display_on = true;
-                    break;
-                        
+
             default:
                     printf("INVALID command %c\n", c);
                     return(-2);
                     break;
         }
+
+        if (p == NULL) return(-1);
     }
-    
-    // if any command to display (text, number or bitmap)
-    if (turn_display_on) { 
-        EPD_DisplayOn = true;   
-        EPD_Display(BlackImage, RedImage);
-        DEV_Delay_ms(2000);
+
+    return(0);
+}
+
+/**
+ * @brief : value of a template variable as number
+ *
+ * @param var : variable number + 1
+ * @param value : receives the number (0 if the variable has no value)
+ *
+ * @return :
+ *  0 = OK
+ * -2 = not a number or out of range
+ */
+int get_value_variable(UBYTE var, UWORD *value)
+{
+    const char *s = DL_Value[var - 1];
+    char *end;
+    double d;
+
+    *value = 0;
+
+    if (s == NULL) return(0);
+
+    d = strtod(s, &end);
+
+    while (*end == ' ') end++;
+
+    if (end == s || *end != 0x0 || ! (d >= 0 && d <= 0xffff)) {
+        p_printf(RED,"invalid number %s for a template variable\n", s);
+        return(-2);
     }
-    
+
+    *value = (UWORD) d;
+
     return(0);
 }
+
 /**
- * @brief : read instructions from file
- * @param optarg: the instruction filename
+ * @brief : fill in the template variables in a text
+ *
+ * @param s : text with variables (see set_text_variables())
+ * @param buf : receives the text (MAXTEXTLENGTH) if needed
+ *
+ * @return : text to use
  */
-void read_from_file(char * optarg)
+const char *get_text_value(const char *s, char *buf)
 {
-    FILE    *fp;
-    bool    in_quotes = false;
-    char    line[MAXTEXTLENGTH], last_char_added;
-    bool    header_char = true;          // waiting for header of instruction
-    bool    escape = false;             // escape character \ detected
-    int     i, s = 0, j=0 ;
-  
-    // open instruction file
-    if ( ! (fp=fopen(optarg,"r")) ) {
-        p_printf(D_RED, "Can not open instruction file %s \n", optarg);
-        close_out(EXIT_FAILURE);
+    const char *v;
+    int i = 0;
+
+    if (strchr(s, DL_VAR) == NULL) return(s);
+
+    while (*s != 0x0 && i < MAXTEXTLENGTH - 1) {
+
+        if (*s == DL_VAR) {
+
+            // variable number + 1 (set_text_variables())
+            if ((UBYTE) s[1] < 1 || (UBYTE) s[1] > TPL_VARS) break;
+
+            if ((v = DL_Value[s[1] - 1]) != NULL)
+                while (*v != 0x0 && i < MAXTEXTLENGTH - 1) buf[i++] = *v++;
+            s += 2;
+        }
+        else
+            buf[i++] = *s++;
     }
-    
-    // get line by line
-    while (fgets(line, MAXTEXTLENGTH, fp)) {
-        
-        // count lines
-        j++;
-                
-        // parse line
-        for(i = 0; i < MAXTEXTLENGTH; i++) {
-            
-            // skip spaces and tabs (if not in quotes)
-            if (line[i] == 0x20 || line[i] == 0x09)
-                if (! in_quotes) continue;
-            
-            // if end of line
-            if (line[i] == 0x0) break;
-            
-            // check for comments or NL/CR             
-            if (line[i] == '#'  || line[i] == 0x0a || line[i] == 0x0d)     
-                if (! in_quotes) break;
+
+    buf[i] = 0x0;
+
+    return(buf);
+}
+
+/**
+ * @brief : perform one op of a display list
+ *
+ * Variables of a template are taken from DL_Value[].
+ *
+ * @return
+ * -2 : invalid template value
+ * -1 : error during execution
+ *  0 : all good
+ */
+int run_op(const DL_OP *op)
+{
+    char buf[MAXTEXTLENGTH];
+    const char *text = op->Text;
+    UWORD v[4];
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (op->Var[i] == 0) v[i] = op->Value[i];
+        else if (get_value_variable(op->Var[i], &v[i])) return(-2);
+    }
+
+    if (op->Text_Vars) text = get_text_value(text, buf);
+
+    switch(op->Code) {
+
+        case 'f':
+            IM_prop.font = op->Font;
+            Debug("Set font to: %s\n",IM_prop.font->Name);
+            break;
+
+        case 'p':
+            IM_prop.Xstart = v[0];
+            IM_prop.Ystart = v[1];
+            break;
+
+        case 'd':
+            IM_prop.front_color = v[0];
+            break;
+
+        case 'b':
+            IM_prop.back_color = v[0];
+            break;
+
+        case 'B':
+            panel_wait();
+            if (! EPD_Awake) hw_init();
+            EPD_Set_Border(op->Option);
             
-            // check for right starting character /    
-            if (header_char) {       
-                
-                if (line[i] != '<') {
-                    p_printf(D_RED,"invalid start character. expected '<' but got %c, 0X%x\n", line[i], line[i]);
-                    fclose(fp);
-                    close_out(EXIT_FAILURE);
-                }
+            // the border shows after a full refresh, also with the same images
+            EPD_PanelValid = false;
+            panel_done();
+            break;
+
+        case 'm':
+            Paint_SetMirroring(v[0]);
+            break;
+
+        case 'r':
+            if (bad_rotation(v[0])) return(-1);
+            Paint_SetRotate(v[0]);
+            break;
+
+        case 'o':
+            IM_prop.dither = v[0];
+            break;
+
+        case '!':
+            if (special_instruction(op->Option)) return(-1);
+            break;
+
+        case 'P':
+            if (bad_pixel(v[0])) return(-1);
+
+            // support colors
+            if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
+
+            Paint_DrawPoint(IM_prop.Xstart, IM_prop.Ystart, BLACK, v[0], DOT_STYLE_DFT);
+
+            Paint_SelectImage(BlackImage);
+
+            // set next start position after POINT
+            IM_prop.Xstart += v[0];
+            break;
+
+        case 'c':
+        case 'C':
+            if (bad_pixel(v[1])) return(-1);
+
+            // support colors
+            if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
+            else Paint_SelectImage(BlackImage);
+
+            Paint_DrawCircle(IM_prop.Xstart, IM_prop.Ystart, v[0], BLACK,
+                op->Code == 'C' ? DRAW_FILL_FULL : DRAW_FILL_EMPTY, v[1]);
+
+            Paint_SelectImage(BlackImage);
+            break;
+
+        case 'q':
+        case 'Q':
+            if (bad_pixel(v[2])) return(-1);
+
+            // support colors
+            if (IM_prop.front_color == COLOR)  Paint_SelectImage(RedImage);
+            else Paint_SelectImage(BlackImage);
+
+            Paint_DrawRectangle(IM_prop.Xstart, IM_prop.Ystart, v[0], v[1], BLACK,
+                op->Code == 'Q' ? DRAW_FILL_FULL : DRAW_FILL_EMPTY, v[2]);
+
+            Paint_SelectImage(BlackImage);
+            break;
+
+        case 'l':
+            if (bad_pixel(v[3])) return(-1);
+
+            Paint_SelectImage(BlackImage);
+            ePaint_DrawLine(IM_prop.Xstart, IM_prop.Ystart, v[0], v[1],
+                IM_prop.front_color, v[2] > 0 ? LINE_STYLE_DOTTED : LINE_STYLE_SOLID, v[3]);
+
+            // set the new X and Y positions.
+            IM_prop.Xstart = v[0] + 1;
+            IM_prop.Ystart = v[1];
+            break;
+
+        case 'i':
+            return(display_BMP(text));
+
+        case 'I':
+            return(load_frame(text));
+
+        case 'W':
+            return(save_frame(text));
+
+        case 'T':
+        case 'D':
+            return(display_time_day(op->Option, op->Code == 'D'));
+
+        case 't':
+        case 'n':
+            return(display_add_font(text, op->Code == 'n'));
+    }
+
+    return(0);
+}
+
+/**
+ * @brief : perform a display list
+ *
+ * @return
+ * -2 : invalid template value
+ * -1 : error during execution
+ *  0 : all good
+ */
+int run_display_list(const DISPLAY_LIST *list)
+{
+    UWORD i;
+    int ret;
+
+    for (i = 0; i < list->Count; i++)
+        if ((ret = run_op(&list->Op[i])) != 0) return(ret);
+
+    // if any command to display (text, number or bitmap)
+    if (list->Display) {
+
+        // displayed by the panel thread
+        if (Async) {
+            Frame_Staged = true;
+            return(0);
+        }
+
+        if (! EPD_Awake) hw_init();
+
+        EPD_DisplayOn = true;
+        if ((ret = display_image()) < 0) return(-1);
+        if (ret) DEV_Delay_ms(2000);
+    }
+
+    return(0);
+}
+
+/**
+ * @brief : compile an instruction and keep it in a display list
+ *
+ * @param ins : instruction
+ * @param len : length of the instruction
+ * @param list : receives the display list, kept as it was on error
+ *
+ * @return
+ * -2 : syntax error
+ * -1 : error in an instruction
+ *  0 : all good
+ */
+int make_display_list(const char *ins, int len, DISPLAY_LIST *list)
+{
+    static DL_OP op[DL_OPS];
+    static char src[MAXINSTRUCTIONS], pool[MAXINSTRUCTIONS];
+    UWORD i, count;
+    bool display;
+    char *mem;
+    int ret;
+
+    memcpy(src, ins, len);
+    src[len] = 0x0;
+
+    if ((ret = compile_instruction(src, op, pool, &count, &display)) != 0)
+        return(ret);
+
+    DL_Compiled++;
+
+    // op, pool and source in one block
+    if ((mem = malloc(count * sizeof(DL_OP) + 2 * (len + 1))) == NULL) {
+        p_printf(RED,"out of memory for display list\n");
+        return(-1);
+    }
+
+    if (list->Op != NULL) free(list->Op);
+
+    list->Op = (DL_OP *) mem;
+    list->Source = mem + count * sizeof(DL_OP);
+    memcpy(list->Source, src, len + 1);
+    memcpy(list->Source + len + 1, pool, len + 1);
+
+    for (i = 0; i < count; i++) {
+        list->Op[i] = op[i];
+        if (op[i].Text) list->Op[i].Text = list->Source + len + 1 + (op[i].Text - pool);
+    }
+
+    list->Count = count;
+    list->Display = display;
+
+    return(0);
+}
+
+/**
+ * @brief : get the display list for Instruction
+ *
+ * The last DL_CACHE display lists are kept, an instruction that was
+ * seen before (the remote clock sends the same layout each minute) is
+ * not parsed again.
+ *
+ * @param ret : receives the compile result on error
+ *
+ * @return : display list or NULL on error
+ */
+DISPLAY_LIST *get_display_list(int *ret)
+{
+    DISPLAY_LIST *list = &DL_Cache[0];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int len = instruction_length(Instruction);
+    UWORD i;
+
+    for (i = 0; i < len; i++) {
+        hash ^= (UBYTE) Instruction[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    DL_Clock++;
+
+    for (i = 0; i < DL_CACHE; i++) {
+
+        if (DL_Cache[i].Used && DL_Cache[i].Hash == hash &&
+            strncmp(DL_Cache[i].Source, Instruction, len) == 0 &&
+            DL_Cache[i].Source[len] == 0x0) {
+            DL_Reused++;
+            DL_Cache[i].Used = DL_Clock;
+            return(&DL_Cache[i]);
+        }
+
+        // free or least recently used entry
+        if (DL_Cache[i].Used < list->Used) list = &DL_Cache[i];
+    }
+
+    if ((*ret = make_display_list(Instruction, len, list)) != 0) return(NULL);
+
+    list->Hash = hash;
+    list->Used = DL_Clock;
+
+    return(list);
+}
+
+/**
+ * @brief : find a template
+ *
+ * @return : template or NULL if not defined
+ */
+TEMPLATE *find_template(const char *name)
+{
+    int i;
+
+    for (i = 0; i < TPL_MAX; i++)
+        if (Templates[i].Name[0] != 0x0 && strcasecmp(Templates[i].Name, name) == 0)
+            return(&Templates[i]);
+
+    return(NULL);
+}
+
+/**
+ * @brief : compile an instruction as template
+ *
+ * Numbers, text and filenames in the instruction can be a variable
+ * {name}, the value is given when the template is drawn (RENDER).
+ * A template with the same name is replaced.
+ *
+ * @param name : template name
+ * @param ins : instruction
+ *
+ * @return
+ * -2 : syntax error
+ * -1 : error in an instruction
+ *  0 : all good
+ */
+int define_template(const char *name, const char *ins)
+{
+    static TEMPLATE tmp;
+    TEMPLATE *tpl;
+    int i, ret;
+
+    if (*name == 0x0 || strlen(name) >= TPL_NAME) {
+        p_printf(RED,"invalid template name %s\n", name);
+        return(-2);
+    }
+
+    // replace or first free entry
+    if ((tpl = find_template(name)) == NULL) {
+
+        for (i = 0; i < TPL_MAX; i++)
+            if (Templates[i].Name[0] == 0x0) break;
+
+        if (i == TPL_MAX) {
+            p_printf(RED,"too many templates (max %d)\n", TPL_MAX);
+            return(-1);
+        }
+
+        tpl = &Templates[i];
+    }
+
+    memset(&tmp, 0x0, sizeof(TEMPLATE));
+    strcpy(tmp.Name, name);
+
+    DL_Template = &tmp;
+    ret = make_display_list(ins, instruction_length(ins), &tmp.List);
+    DL_Template = NULL;
+
+    if (ret != 0) return(ret);
+
+    if (tpl->List.Op != NULL) free(tpl->List.Op);
+    *tpl = tmp;
+
+    Debug("template %s has %d variables\n", tpl->Name, tpl->Vars);
+
+    return(0);
+}
+
+/**
+ * @brief : draw a template with values
+ *
+ * @param p : name followed by the values name=value;name=value
+ *   ended with > (use \; \> or \\ for ; > or \ in a value)
+ *
+ * @return
+ * -2 : unknown template or variable, invalid value
+ * -1 : error during execution
+ *  0 : all good
+ */
+int render_template(char *p)
+{
+    TEMPLATE *tpl;
+    char *name, *value, *d;
+    int i, ret;
+
+    while (*p == ' ') p++;
+
+    for (name = p; *p != ' ' && *p != '>' && *p != 0x0; p++);
+
+    if (*p != 0x0) *p++ = 0x0;
+
+    if ((tpl = find_template(name)) == NULL) {
+        p_printf(RED,"unknown template %s\n", name);
+        return(-2);
+    }
+
+    memset(DL_Value, 0x0, sizeof(DL_Value));
+
+    // values are stored in place, without the escapes
+    while (*p != '>' && *p != 0x0) {
+
+        while (*p == ' ' || *p == ';') p++;
+
+        for (name = p; *p != '=' && *p != '>' && *p != 0x0; p++);
+
+        if (*p != '=') break;
+
+        *p++ = 0x0;
+
+        for (value = d = p; *p != ';' && *p != '>' && *p != 0x0; p++) {
+            if (*p == '\\' && p[1] != 0x0) p++;
+            *d++ = *p;
+        }
+
+        if (*p == ';') p++;
+
+        *d = 0x0;
+
+        for (i = 0; i < tpl->Vars; i++)
+            if (strcmp(tpl->Var[i], name) == 0) break;
+
+        if (i == tpl->Vars) {
+            p_printf(RED,"template %s has no variable %s\n", tpl->Name, name);
+            return(-2);
+        }
+
+        DL_Value[i] = value;
+    }
+
+    ret = run_display_list(&tpl->List);
+
+    memset(DL_Value, 0x0, sizeof(DL_Value));
+
+    return(ret);
+}
+
+/**
+ * @brief parse formatted string
+ * 
+ * The string is compiled into a display list once (get_display_list())
+ * and the display list is performed.
+ * 
+ * <    start of instructions
+ *  B=#     set border color (BWC)
+ * 
+ *  f=#     set font to use
+ *  p=x:y   set start position to display
+ * 
+ *  d=#     set foreground color (BWC)
+ *  b=#     set background color (BWC)
+ * 
+ *  i=''    load image on current position
+ *  I=''    load frame file
+ *  W=''    write frame file
+ *  t=''    display text
+ *  n=''    display number
+ * 
+ *  l=X:Y;Z:s   drawline X end, Y end, Z = style, s = size
+ * 
+ *  m=#     mirror image (N,O,H,V)
+ * 
+ *  o=#     image colors (N,C,F,O)
+ * 
+ *  P=s     draw a point s = size
+ * 
+ *  r=#     rotate 0,90,270, 360
+ * 
+ *  c=r:s   draw empty circle R = radius pixelsize s
+ *  C=r:s   draw filled circle R = radius pixelsize s
+ * 
+ *  q=X:Y:s draw empty rectangle X end, Y end, s = pixel size
+ *  Q=X:Y:s draw filled rectangle X end, Y end, s = pixel size
+ * 
+ *  T=n or s display time (s means include seconds, n = not include)
+ *  D=n or w display date as numbers(n) or words(w)
+ * 
+ *  !=      special instructions
+ *      c   perform a clear screen
+ *      d   display the current X / Y positions
+ *      s   save the current X / Y positions
+ *      r   restore the saved X / Y positions
+ *      more here..............
+ * 
+ * >    end of instructions
+ * 
+ * @return
+ * -2 : syntax error
+ * -1 : error during execution
+ * 
+ *  0 : all good
+ *  else offset to *P where end was found
+ */
+int parse_string_instruction()
+{
+    DISPLAY_LIST *list;
+    int ret;
+   
+    if ((list = get_display_list(&ret)) == NULL) return(ret);
+    
+    return(run_display_list(list));
+}
+/**
+ * @brief : read instructions from file
+ * @param optarg: the instruction filename
+ * @param ins : receives the instruction (MAXINSTRUCTIONS)
+ */
+void read_from_file(char * optarg, char *ins)
+{
+    FILE    *fp;
+    bool    in_quotes = false;
+    char    line[MAXTEXTLENGTH], last_char_added;
+    bool    header_char = true;          // waiting for header of instruction
+    bool    escape = false;             // escape character \ detected
+    int     i, s = 0, j=0 ;
+  
+    // open instruction file
+    if ( ! (fp=fopen(optarg,"r")) ) {
+        p_printf(D_RED, "Can not open instruction file %s \n", optarg);
+        close_out(EXIT_FAILURE);
+    }
+    
+    // get line by line
+    while (fgets(line, MAXTEXTLENGTH, fp)) {
+        
+        // count lines
+        j++;
+                
+        // parse line
+        for(i = 0; i < MAXTEXTLENGTH; i++) {
+            
+            // skip spaces and tabs (if not in quotes)
+            if (line[i] == 0x20 || line[i] == 0x09)
+                if (! in_quotes) continue;
+            
+            // if end of line
+            if (line[i] == 0x0) break;
+            
+            // check for comments or NL/CR             
+            if (line[i] == '#'  || line[i] == 0x0a || line[i] == 0x0d)     
+                if (! in_quotes) break;
+            
+            // check for right starting character /    
+            if (header_char) {       
+                
+                if (line[i] != '<') {
+                    p_printf(D_RED,"invalid start character. expected '<' but got %c, 0X%x\n", line[i], line[i]);
+                    fclose(fp);
+                    close_out(EXIT_FAILURE);
+                }
                 
                 header_char = false;
             } 
  
-            Instruction[s++] = line[i]; 
+            ins[s++] = line[i]; 
             
             // save last character added for check later
             last_char_added = line[i];
@@ -1287,217 +2332,1080 @@ void read_from_file(char * optarg)
                 escape = true;
                 continue;
             }
-            
-            // if no escape character was captured
-            if (! escape)  {
-                               
-                // toggle in quotes
-                if (line[i] == '\'') in_quotes = ! in_quotes;
+            
+            // if no escape character was captured
+            if (! escape)  {
+                               
+                // toggle in quotes
+                if (line[i] == '\'') in_quotes = ! in_quotes;
+            }
+            else    // reset escape character
+                escape = false;
+        } // total line check
+        
+        // do a number of checks after end of line
+        if (in_quotes)
+        {
+            p_printf(D_RED,"Closing quote missing in line: %s\n", line);
+            fclose(fp);
+            close_out(EXIT_FAILURE);
+        }           
+
+        // weak check, but still... if not start or end indicator
+        // last valid character on a line MUST be a comma ,
+        if (last_char_added!= '<' &&  last_char_added != '>' && i != 0) {
+            
+            if (ins[s-1] != ',') {
+                p_printf(D_RED,"Expected comma at end of line, but got '%c' , 0x%x\n", line[s-1], line [s-1]);
+                printf("line %d in question is %s\n",j, line);
+                fclose(fp);
+                close_out(EXIT_FAILURE);
+            }
+        }
+    } // done all lines from file   
+     
+    fclose(fp);
+    
+    // the last character added should hold the terminator or the instruction   
+    if (last_char_added != '>') {
+        p_printf (D_RED,"Expected > end of line, but got '%c', 0x%x", last_char_added, last_char_added);
+        close_out(EXIT_FAILURE);
+    } 
+    
+    ins[s] = 0x0;
+    
+    // debug only
+    Debug("instruction : %s\n", ins);
+}
+
+/**
+ * @brief : read a template from file
+ * @param optarg: name:filename
+ */
+void define_file_template(char * optarg)
+{
+    char ins[MAXINSTRUCTIONS];
+    char *file = strchr(optarg, ':');
+    
+    if (file == NULL) {
+        p_printf(D_RED, "expected name:file, got %s\n", optarg);
+        close_out(EXIT_FAILURE);
+    }
+    
+    *file++ = 0x0;
+    
+    read_from_file(file, ins);
+    
+    if (define_template(optarg, ins) != 0) {
+        p_printf(D_RED, "invalid template %s in %s\n", optarg, file);
+        close_out(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief add a handle to the handles to wait for
+ *
+ * @param fd : handle to read from
+ * @param c : client, NULL for the listening socket, &close_fd to close down
+ */
+void watch_fd(int fd, void *c)
+{
+    struct epoll_event ev;
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = c;
+
+    if (epoll_ctl(ep_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        printf("can not wait for input on handle %d\n", fd);
+        close_out(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief start a client with empty buffers
+ */
+void client_reset(CLIENT *c)
+{
+    c->Serial = ++Client_Serial;
+    c->Failed = false;
+    c->Len = 0;
+    c->Template_Name[0] = 0x0;
+    c->Framed = false;
+    c->Msg_Len = c->Msg_Skip = 0;
+}
+
+/**
+ * @brief open named pipes in case of inter-process communication
+ */
+void connect_pipes()
+{
+    CLIENT *c = &Clients[0];
+
+    // open input pipe from other program (open O_RDWR to prevent blocking)
+    if ( (c->Fd_r = open(name_pipe_r,O_RDWR)) < 0)
+    {
+        printf("can not open named pipe %s\n", name_pipe_r);
+        close_out(EXIT_FAILURE);
+    }
+
+    // open return pipe to other program (open O_RDWR to prevent blocking)
+    // a program that does not read the replies must not block epaper
+    if ( (c->Fd_w = open(name_pipe_w,O_RDWR | O_NONBLOCK)) < 0)
+    {
+        printf("can not open named pipe %s\n", name_pipe_w);
+        close_out(EXIT_FAILURE);
+    }
+
+    client_reset(c);
+    watch_fd(c->Fd_r, c);
+
+    Debug("pipes have been connected : %s, %s\n", name_pipe_r, name_pipe_w);
+
+}
+
+/**
+ * @brief listen on a unix socket for remote programs
+ */
+void open_socket()
+{
+    struct sockaddr_un addr;
+    struct stat st;
+
+    if (strlen(name_socket) >= sizeof(addr.sun_path)) {
+        printf("socket name too long : %s\n", name_socket);
+        close_out(EXIT_FAILURE);
+    }
+
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, name_socket);
+
+    // a client that has gone should not stop the server
+    signal(SIGPIPE, SIG_IGN);
+
+    // remove the socket of an earlier run
+    if (stat(name_socket, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(name_socket);
+
+    if ((sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0)) < 0 ||
+        bind(sock_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+        listen(sock_fd, MAXCLIENTS) < 0)
+    {
+        printf("can not listen on socket %s\n", name_socket);
+        close_out(EXIT_FAILURE);
+    }
+
+    watch_fd(sock_fd, NULL);
+
+    Debug("listening on socket %s\n", name_socket);
+}
+
+/**
+ * @brief accept a remote program on the socket
+ */
+void accept_client()
+{
+    int fd, i;
+
+    // a program that does not read the replies must not block epaper
+    if ((fd = accept4(sock_fd, NULL, NULL, SOCK_NONBLOCK)) < 0) return;
+
+    // Clients[0] are the named pipes
+    for (i = 1; i <= MAXCLIENTS; i++)
+        if (Clients[i].Fd_r < 0) break;
+
+    if (i > MAXCLIENTS) {
+        printf("too many remote programs (max %d)\n", MAXCLIENTS);
+        close(fd);
+        return;
+    }
+
+    pthread_mutex_lock(&Client_Lock);
+    client_reset(&Clients[i]);
+    Clients[i].Fd_r = Clients[i].Fd_w = fd;
+    pthread_mutex_unlock(&Client_Lock);
+
+    watch_fd(fd, &Clients[i]);
+
+    Debug("client %d connected\n", i);
+}
+
+/**
+ * @brief close a client that has gone, the named pipes are opened again
+ *
+ * Its requests that are waiting are still performed, without sending
+ * the result (the connection number has changed).
+ */
+void close_client(CLIENT *c)
+{
+    pthread_mutex_lock(&Client_Lock);
+
+    epoll_ctl(ep_fd, EPOLL_CTL_DEL, c->Fd_r, NULL);
+    close(c->Fd_r);
+    if (c->Fd_w != c->Fd_r) close(c->Fd_w);
+    c->Fd_r = c->Fd_w = -1;
+    c->Serial = 0;
+
+    if (c == &Clients[0]) {
+        printf("lost connection ? Closing pipes and try to reconnect\n");
+        connect_pipes();
+    }
+    else
+        Debug("client %d has gone\n", (int) (c - Clients));
+
+    pthread_mutex_unlock(&Client_Lock);
+}
+
+/**
+ * @brief write to a remote program
+ *
+ * A client that can not be written to is closed after reading. The
+ * handles do not block: a client that does not read the replies is
+ * closed, it does not stop the others.
+ *
+ * @param c : client
+ * @param serial : connection the data is for
+ *
+ * @return
+ * 0 = OK
+ * -1 = error or the connection has gone
+ */
+int client_write(CLIENT *c, UDOUBLE serial, const void *buf, int len)
+{
+    int ret = -1;
+
+    // the render and panel threads sent results too (-A)
+    pthread_mutex_lock(&Client_Lock);
+
+    if (c->Serial == serial && ! c->Failed) {
+
+        if (write(c->Fd_w, buf, len) == len)
+            ret = 0;
+        else {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                printf("Remote program does not read the replies\n");
+            else
+                printf("Error during writing to remote program\n");
+            c->Failed = true;
+        }
+    }
+
+    pthread_mutex_unlock(&Client_Lock);
+
+    return(ret);
+}
+
+/**
+ * @brief sent a buffer to the remote program
+ *
+ * @param c : client
+ * @param serial : connection the buffer is for
+ */
+int sent_to_pipe(CLIENT *c, UDOUBLE serial, char *buf)
+{
+    // let remote program know
+    if (client_write(c, serial, buf, strlen(buf)) != 0) return(-1);
+
+    Debug("sent to pipe : %s\n", buf);
+
+    return(0);
+}
+
+/**
+ * @brief sent a reply to the client of a request
+ *
+ * @param req : request
+ * @param ret : result (framed reply)
+ * @param buf : text reply
+ */
+void sent_reply(RENDER_REQ *req, int ret, char *buf)
+{
+    UBYTE msg[PIPE_MSG_HEADER + 1];
+
+    // framed reply : the result as one byte
+    if (req->Framed) {
+        pipe_msg_set(msg, PIPE_MSG_REPLY, 1, req->Id);
+        msg[PIPE_MSG_HEADER] = (UBYTE) ret;
+
+        if (client_write(req->Client, req->Serial, msg, sizeof(msg)) == 0)
+            Debug("sent to pipe : reply %u, %s\n", req->Id, buf);
+    }
+    else
+        sent_to_pipe(req->Client, req->Serial, buf);
+}
+
+/**
+ * @brief sent the result of a request to the remote program
+ *
+ * @param req : request from the render queue
+ * @param ret : result of the request (0 = OK)
+ */
+void sent_result(RENDER_REQ *req, int ret)
+{
+    char ret_buf[20];      // sent to program
+
+    // set EPD to deepsleep, now or after the idle window
+    panel_idle();
+
+    // check for result
+    if (ret == 0) {
+        Debug("execution succesfull\n");
+        sprintf(ret_buf, "<<OK>>");
+    }
+    else {
+        Debug("Error during execution : %s\n", req->Data ? req->Data : "");
+        sprintf(ret_buf, "<<ERROR%d>>",ret);
+    }
+
+    sent_reply(req, ret, ret_buf);
+}
+
+/**
+ * @brief : replace the frame of a waiting panel job by a later frame (-L)
+ *
+ * The request of the job is kept, it gets <<COALESCED>> when the later
+ * frame is displayed. The earlier frame is never displayed, the changed
+ * area is the union of both.
+ *
+ * @param job : job waiting for the panel (PQ_Lock is held)
+ * @param req : request of the later frame
+ * @param f : later frame (BlackImage and RedImage)
+ */
+void coalesce_frame(PANEL_JOB *job, RENDER_REQ *req, const DISPLAY_FRAME *f)
+{
+    RENDER_REQ *old = &job->Coalesced[job->Num_Coalesced++];
+    DISPLAY_FRAME *jf = &job->Frame;
+
+    *old = job->Req;
+    if (old->Data != NULL) {
+        free(old->Data);
+        old->Data = NULL;
+    }
+
+    job->Req = *req;
+
+    if (jf->Dirty && f->Dirty) {
+        if (f->Xstart < jf->Xstart) jf->Xstart = f->Xstart;
+        if (f->Ystart < jf->Ystart) jf->Ystart = f->Ystart;
+        if (f->Xend > jf->Xend) jf->Xend = f->Xend;
+        if (f->Yend > jf->Yend) jf->Yend = f->Yend;
+    }
+    else
+        jf->Dirty = false;
+
+    jf->Hash = f->Hash;
+    memcpy(job->Black, f->Black, EPD_PLANE_BYTES);
+    memcpy(job->Red, f->Red, EPD_PLANE_BYTES);
+
+    Frames_Coalesced++;
+    Debug("frame replaced while the display is busy, %d request(s) coalesced\n", job->Num_Coalesced);
+}
+
+/**
+ * @brief : add the result and frame of a request to the panel queue (-A)
+ *
+ * The images are copied, the render thread can draw the next request
+ * while the panel is refreshed. With -L the frame replaces the frame
+ * that is waiting for the panel (latest wins).
+ *
+ * @param req : request, the panel thread releases req->Data
+ * @param ret : result of the request
+ */
+void queue_panel(RENDER_REQ *req, int ret)
+{
+    PANEL_JOB *job;
+    DISPLAY_FRAME f;
+    bool display = Frame_Staged && ret == 0;
+    bool coalesced = false;
+
+    Frame_Staged = false;
+
+    if (display) display_prepare(&f);
+
+    pthread_mutex_lock(&PQ_Lock);
+    pthread_cleanup_push(unlock_mutex, &PQ_Lock);
+
+    // the first job is being displayed, the last one is waiting
+    if (Latest_Wins && display && PQ_Count > 1) {
+
+        job = &PQ[(PQ_Head + PQ_Count - 1) % PQ_MAX];
+
+        if (job->Display && job->Num_Coalesced < PQ_COALESCE) {
+            coalesce_frame(job, req, &f);
+            coalesced = true;
+        }
+    }
+
+    if (! coalesced) {
+        while (PQ_Count == PQ_MAX) pthread_cond_wait(&PQ_Done, &PQ_Lock);
+
+        job = &PQ[(PQ_Head + PQ_Count) % PQ_MAX];
+    }
+
+    pthread_cleanup_pop(1);
+
+    if (coalesced) return;
+
+    // the slot is not used by the panel thread until it is counted
+    job->Req = *req;
+    job->Ret = ret;
+    job->Display = display;
+    job->Num_Coalesced = 0;
+
+    if (display) {
+        job->Frame = f;
+
+        // not Paint_ImageCopy(), that would mark the images as changed
+        memcpy(job->Black, f.Black, EPD_PLANE_BYTES);
+        memcpy(job->Red, f.Red, EPD_PLANE_BYTES);
+        job->Frame.Black = job->Black;
+        job->Frame.Red = job->Red;
+
+        // the frame file can be closed before the frame is displayed
+        job->Frame.Packed = NULL;
+    }
+
+    pthread_mutex_lock(&PQ_Lock);
+    PQ_Count++;
+    pthread_cond_signal(&PQ_Ready);
+    pthread_mutex_unlock(&PQ_Lock);
+}
+
+/**
+ * @brief : panel thread (-A), display the frames and sent the results
+ */
+void *panel_thread(void *arg)
+{
+    PANEL_JOB *job;
+    struct timespec ts;
+    uint64_t one = 1;
+    int i, t, ret;
+
+    while (1) {
+
+        pthread_mutex_lock(&PQ_Lock);
+        pthread_cleanup_push(unlock_mutex, &PQ_Lock);
+
+        while (PQ_Count == 0) {
+
+            // deep sleep after the idle window (-i)
+            if (Panel_Direct || (t = idle_timeout()) < 0)
+                pthread_cond_wait(&PQ_Ready, &PQ_Lock);
+
+            else if (t == 0) {
+                Debug("no request for %d seconds\n", Idle_Sleep);
+                panel_sleep();
+            }
+            else {
+                ts.tv_sec = Sleep_At / 1000;
+                ts.tv_nsec = (Sleep_At % 1000) * 1000000;
+                pthread_cond_timedwait(&PQ_Ready, &PQ_Lock, &ts);
             }
-            else    // reset escape character
-                escape = false;
-        } // total line check
-        
-        // do a number of checks after end of line
-        if (in_quotes)
-        {
-            p_printf(D_RED,"Closing quote missing in line: %s\n", line);
-            fclose(fp);
-            close_out(EXIT_FAILURE);
-        }           
+        }
+
+        job = &PQ[PQ_Head];
+
+        pthread_cleanup_pop(1);
+
+        if (job->Display) {
+
+            if (! EPD_Awake) hw_init();
+
+            EPD_DisplayOn = true;
+            if ((ret = display_frame(&job->Frame)) < 0) job->Ret = -1;
+            else if (ret) DEV_Delay_ms(2000);
+        }
+
+        // the main thread closes down, it stops the threads
+        if (job->Req.Type == PIPE_MSG_CLOSE) {
+            if (job->Req.Data != NULL) free(job->Req.Data);
+            if (write(close_fd, &one, sizeof(one)) < 0)
+                printf("can not ask to close down\n");
+            return(NULL);
+        }
+
+        // requests with a frame that was replaced by this one (-L)
+        for (i = 0; i < job->Num_Coalesced; i++) {
+            if (job->Ret < 0) sent_result(&job->Coalesced[i], job->Ret);
+            else sent_reply(&job->Coalesced[i], PIPE_MSG_COALESCED, "<<COALESCED>>");
+        }
+
+        sent_result(&job->Req, job->Ret);
+
+        if (job->Req.Data != NULL) free(job->Req.Data);
+
+        // free the slot
+        pthread_mutex_lock(&PQ_Lock);
+        PQ_Head = (PQ_Head + 1) % PQ_MAX;
+        PQ_Count--;
+        pthread_cond_broadcast(&PQ_Done);
+        pthread_mutex_unlock(&PQ_Lock);
+    }
+
+    return(NULL);
+}
+
+/**
+ * @brief perform a request from the render queue
+ *
+ * With -A the result and the frame go to the panel queue, the panel
+ * thread displays the frame and sends the result.
+ */
+void run_request(RENDER_REQ *req)
+{
+    int ret = req->Ret;
+
+    // close down after the requests before it
+    if (req->Type == PIPE_MSG_CLOSE) {
+        if (! Async) close_out(EXIT_SUCCESS);
+        queue_panel(req, 0);
+        return;
+    }
+
+    if (req->Type != PIPE_MSG_REPLY) {
+
+        // let remote know execution is starting
+        if (! req->Framed) sent_to_pipe(req->Client, req->Serial, "<<START>>");
+
+        Debug("Pipe got request %d : %s\n", req->Type, req->Data);
+    }
+
+    switch(req->Type) {
+
+        case PIPE_MSG_INSTRUCTION:
+            strcpy(Instruction, req->Data);
+            ret = parse_string_instruction();
+            break;
+
+        case PIPE_MSG_TEMPLATE:
+            ret = define_template(req->Name, req->Data);
+            break;
+
+        case PIPE_MSG_RENDER:
+            ret= render_template(req->Data);
+            break;
+    }
+
+    if (Async) queue_panel(req, ret);
+    else sent_result(req, ret);
+
+    // reset buffers
+    memset(Instruction, 0x0, MAXINSTRUCTIONS);
+}
+
+/**
+ * @brief take the first request from the render queue
+ *
+ * @param req : receives the request
+ */
+void next_request(RENDER_REQ *req)
+{
+    pthread_mutex_lock(&RQ_Lock);
+    pthread_cleanup_push(unlock_mutex, &RQ_Lock);
+
+    while (RQ_Count == 0) pthread_cond_wait(&RQ_Ready, &RQ_Lock);
+
+    *req = RQ[RQ_Head];
+    RQ_Head = (RQ_Head + 1) % RQ_MAX;
+    RQ_Count--;
+
+    pthread_cond_signal(&RQ_Space);
+    pthread_cleanup_pop(1);
+}
+
+/**
+ * @brief perform the requests in the render queue, in order
+ */
+void run_queue()
+{
+    RENDER_REQ req;
+
+    while (RQ_Count > 0) {
+
+        next_request(&req);
+
+        run_request(&req);
+
+        if (req.Data != NULL) free(req.Data);
+    }
+}
+
+/**
+ * @brief : render thread (-A), draw the requests from the render queue
+ */
+void *render_thread(void *arg)
+{
+    RENDER_REQ req;
 
-        // weak check, but still... if not start or end indicator
-        // last valid character on a line MUST be a comma ,
-        if (last_char_added!= '<' &&  last_char_added != '>' && i != 0) {
-            
-            if (Instruction[s-1] != ',') {
-                p_printf(D_RED,"Expected comma at end of line, but got '%c' , 0x%x\n", line[s-1], line [s-1]);
-                printf("line %d in question is %s\n",j, line);
-                fclose(fp);
-                close_out(EXIT_FAILURE);
-            }
+    while (1) {
+
+        next_request(&req);
+
+        run_request(&req);
+    }
+
+    return(NULL);
+}
+
+/**
+ * @brief start the render and panel threads (-A)
+ */
+void start_threads()
+{
+    pthread_condattr_t attr;
+    sigset_t set, old;
+    int i;
+
+    for (i = 0; i < PQ_MAX; i++) {
+        PQ[i].Black = malloc(EPD_PLANE_BYTES);
+        PQ[i].Red = malloc(EPD_PLANE_BYTES);
+
+        if (PQ[i].Black == NULL || PQ[i].Red == NULL) {
+            printf("Failed to apply for panel queue memory...\n");
+            close_out(EXIT_FAILURE);
         }
-    } // done all lines from file   
-     
-    fclose(fp);
-    
-    // the last character added should hold the terminator or the instruction   
-    if (last_char_added != '>') {
-        p_printf (D_RED,"Expected > end of line, but got '%c', 0x%x", last_char_added, last_char_added);
+    }
+
+    // the idle window (-i) ends at a now_ms() time
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&PQ_Ready, &attr);
+    pthread_condattr_destroy(&attr);
+
+    // signals are handled by the main thread
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, &old);
+
+    if (pthread_create(&Render_Tid, NULL, render_thread, NULL) != 0 ||
+        pthread_create(&Panel_Tid, NULL, panel_thread, NULL) != 0) {
+        printf("can not start the render and panel threads\n");
         close_out(EXIT_FAILURE);
-    } 
-    
-    Instruction[s] = 0x0;
-    
-    // debug only
-    Debug("instruction : %s\n", Instruction);
+    }
+
+    Threads_Started = true;
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    Debug("render and panel threads started\n");
 }
 
 /**
- * @brief open named pipes in case of inter-process communication
+ * @brief add a request to the render queue
+ *
+ * When the queue is full, the waiting requests are performed first (or
+ * with -A, wait for the render thread). With -A a framed request is
+ * acknowledged with PIPE_MSG_QUEUED. A text client has no id to match a
+ * later result, it gets <<START>> and the result as without -A.
+ *
+ * @param c : client that sent the request
+ * @param req : request, Client, Serial, Framed and Data are set here
+ * @param data : instruction or values (NULL if none)
+ * @param len : length of data
  */
-void connect_pipes()
+void queue_request(CLIENT *c, RENDER_REQ *req, const char *data, int len)
 {
-    // open input pipe from other program (open O_RDWR to prevent blocking)
-    if ( (p_fd_r = open(name_pipe_r,O_RDWR)) < 0)
-    {
-        printf("can not open named pipe %s\n", name_pipe_r);
-        close_out(EXIT_FAILURE);
+    req->Client = c;
+    req->Serial = c->Serial;
+    req->Framed = c->Framed;
+    req->Data = NULL;
+
+    if (data != NULL) {
+
+        if ((req->Data = malloc(len + 1)) == NULL) {
+            p_printf(RED,"out of memory for request\n");
+            req->Type = PIPE_MSG_REPLY;
+            req->Ret = -1;
+        }
+        else {
+            memcpy(req->Data, data, len);
+            req->Data[len] = 0x0;
+        }
     }
 
-    // open return pipe to other program (open O_RDWR to prevent blocking)
-    if ( (p_fd_w = open(name_pipe_w,O_RDWR)) < 0)
-    {
-        printf("can not open named pipe %s\n", name_pipe_w);
-        close_out(EXIT_FAILURE);
+    if (! Async && RQ_Count == RQ_MAX) run_queue();
+
+    pthread_mutex_lock(&RQ_Lock);
+
+    while (RQ_Count == RQ_MAX) pthread_cond_wait(&RQ_Space, &RQ_Lock);
+
+    pthread_mutex_unlock(&RQ_Lock);
+
+    // before the render thread can sent the result
+    if (Async && req->Framed && req->Type != PIPE_MSG_REPLY && req->Type != PIPE_MSG_CLOSE)
+        sent_reply(req, PIPE_MSG_QUEUED, "<<QUEUED>>");
+
+    pthread_mutex_lock(&RQ_Lock);
+
+    RQ[(RQ_Head + RQ_Count) % RQ_MAX] = *req;
+    RQ_Count++;
+
+    pthread_cond_signal(&RQ_Ready);
+    pthread_mutex_unlock(&RQ_Lock);
+}
+
+/**
+ * @brief queue a framed message
+ *
+ * @param c : client that sent the message
+ * @param type : PIPE_MSG_xxx
+ * @param id : id of the message
+ * @param payload : payload of the message
+ * @param len : length of the payload (less than MAXINSTRUCTIONS)
+ */
+void framed_message(CLIENT *c, UBYTE type, uint32_t id, const char *payload, UWORD len)
+{
+    RENDER_REQ req = {0};
+    int i;
+
+    req.Type = type;
+    req.Id = id;
+
+    switch(type) {
+
+        case PIPE_MSG_INSTRUCTION:
+        case PIPE_MSG_RENDER:
+            queue_request(c, &req, payload, len);
+            break;
+
+        case PIPE_MSG_TEMPLATE:     // name<instruction>
+            for (i = 0; i < len && payload[i] != '<'; i++);
+
+            if (i == len || i >= TPL_NAME) {
+                p_printf(D_RED, "invalid template name\n");
+                req.Type = PIPE_MSG_REPLY;
+                req.Ret = -2;
+                queue_request(c, &req, NULL, 0);
+                break;
+            }
+
+            sprintf(req.Name, "%.*s", i, payload);
+            queue_request(c, &req, payload + i, len - i);
+            break;
+
+        case PIPE_MSG_TEXT:
+            req.Type = PIPE_MSG_REPLY;
+            queue_request(c, &req, NULL, 0);
+            c->Framed = false;
+            break;
+
+        case PIPE_MSG_CLOSE:        // after what was sent before
+            queue_request(c, &req, NULL, 0);
+            break;
+
+        default:
+            p_printf(D_RED, "unknown message type %d\n", type);
+            req.Type = PIPE_MSG_REPLY;
+            req.Ret = -2;
+            queue_request(c, &req, NULL, 0);
+            break;
     }
-    
-    Debug("pipes have been connected : %s, %s\n", name_pipe_r, name_pipe_w);
-    
 }
 
 /**
- * @brief sent a buffer to the remote program
+ * @brief collect framed messages from the received data
+ *
+ * A message can arrive in several reads, a read can hold several
+ * messages. Each complete message is queued.
+ *
+ * @param c : client that sent the data
+ * @param buf : received data
+ * @param n : bytes in buf
+ *
+ * @return : bytes used, less than n after PIPE_MSG_TEXT
  */
-int sent_to_pipe(char *buf)
+int framed_input(CLIENT *c, const char *buf, int n)
 {
-    // let remote program know
-    if (write(p_fd_w, buf, strlen(buf)) != strlen(buf))
-    {
-        printf("Error during writing to remote program\n");
-        return(-1);
+    RENDER_REQ req = {0};
+    UBYTE type = 0;
+    UWORD len = 0;
+    uint32_t id = 0;
+    int need, m, used = 0;
+
+    while (used < n && c->Framed) {
+
+        // rest of a message that was too long
+        if (c->Msg_Skip > 0) {
+            m = n - used < c->Msg_Skip ? n - used : c->Msg_Skip;
+            c->Msg_Skip -= m;
+            used += m;
+            continue;
+        }
+
+        // header first, then the payload
+        need = PIPE_MSG_HEADER;
+        if (c->Msg_Len >= PIPE_MSG_HEADER) {
+            pipe_msg_get(c->Msg, &type, &len, &id);
+            need += len;
+        }
+
+        m = need - c->Msg_Len;
+        if (m > n - used) m = n - used;
+
+        memcpy(c->Msg + c->Msg_Len, buf + used, m);
+        c->Msg_Len += m;
+        used += m;
+
+        if (c->Msg_Len < need) break;
+
+        if (need == PIPE_MSG_HEADER) {
+
+            if (pipe_msg_get(c->Msg, &type, &len, &id) != 0) {
+                p_printf(D_RED, "invalid framed message, input dropped\n");
+                c->Msg_Len = 0;
+                return(n);
+            }
+
+            if (len >= MAXINSTRUCTIONS) {
+                printf("Too many instructions for buffer : %d\n", len);
+                c->Msg_Len = 0;
+                c->Msg_Skip = len;
+                req.Type = PIPE_MSG_REPLY;
+                req.Id = id;
+                req.Ret = PIPE_MSG_OVERRUN;
+                queue_request(c, &req, NULL, 0);
+                continue;
+            }
+
+            // wait for the payload
+            if (len > 0) continue;
+        }
+
+        c->Msg_Len = 0;
+        framed_message(c, type, id, (char *) c->Msg + PIPE_MSG_HEADER, len);
     }
-    
-    Debug("sent to pipe : %s\n", buf);
-    
-    return(0);  
+
+    return(used);
 }
 
 /**
- * @brief read and parse and communicate with remote program
+ * @brief collect text instructions from the received data
+ *
+ * @param c : client that sent the data
+ * @param buf : received data, terminated with 0x0
+ * @param n : bytes in buf
+ *
+ * @return : bytes used, less than n after <<FRAMED>>
  */
-void Comm_Over_Pipe()
+int text_input(CLIENT *c, char *buf, int n)
 {
-    // connect read and write pipe
-    connect_pipes();
-    
-    int  ret, j, i, n;
+    RENDER_REQ req = {0};
+    char *s;
+    int j;
+
+    Debug("received %s, with length %d\n", buf, n);
+
+    // check for instruction to start all over
+    if (strstr(buf,"<<NEW>>") != NULL) {
+        c->Len = 0;
+        c->Template_Name[0] = 0x0;
+        return(n);
+    }
+
+    // check for instruction to close down
+    if (strstr(buf,"<<CLOSE>>") != NULL) {
+        // after what was sent before
+        req.Type = PIPE_MSG_CLOSE;
+        queue_request(c, &req, NULL, 0);
+        return(n);
+    }
+
+    // switch to framed messages
+    if ((s = strstr(buf,"<<FRAMED>>")) != NULL) {
+        c->Len = 0;
+        c->Template_Name[0] = 0x0;
+        sent_to_pipe(c, c->Serial, "<<FRAMED>>");
+
+        c->Framed = true;
+        c->Msg_Len = c->Msg_Skip = 0;
+
+        // messages that were sent right after
+        return(s + strlen("<<FRAMED>>") - buf);
+    }
+
+    // next instruction is a template
+    if ((s = strstr(buf,"<<TEMPLATE")) != NULL) {
+        c->Len = 0;
+        s += strlen("<<TEMPLATE");
+        while (*s == ' ') s++;
+        j = strcspn(s, ">");
+
+        if (j == 0 || j >= TPL_NAME) {
+            p_printf(D_RED, "invalid template name\n");
+            sent_to_pipe(c, c->Serial, "<<ERROR-2>>");
+            return(n);
+        }
+
+        sprintf(c->Template_Name, "%.*s", j, s);
+        sent_to_pipe(c, c->Serial, "<<MORE>>");
+        return(n);
+    }
+
+    // draw a template with values
+    if ((s = strstr(buf,"<<RENDER")) != NULL) {
+        c->Len = 0;
+        s += strlen("<<RENDER");
+        req.Type = PIPE_MSG_RENDER;
+        queue_request(c, &req, s, strlen(s));
+        return(n);
+    }
+
+    // parse incoming EPD instruction
+    for (j = 0; j < n; j++) {
+
+        // skip CR, LF and spaces between instructions
+        if (c->Len == 0 && (buf[j] == ' ' || buf[j] == 0x0d || buf[j] == 0x0a)) continue;
+
+        if (c->Len == MAXINSTRUCTIONS - 1) {
+            c->Buf[c->Len] = 0x0;
+            printf("Too many instructions for buffer : %s\n", c->Buf);
+            sent_to_pipe(c, c->Serial, "<<OVERRUN>>");
+            c->Len = 0;
+            return(n);
+        }
+
+        c->Buf[c->Len++] = buf[j];
+
+        // check for last character
+        if (buf[j] == '>') {
+
+            // keep as template or execute received instruction
+            if (c->Template_Name[0] != 0x0) {
+                req.Type = PIPE_MSG_TEMPLATE;
+                strcpy(req.Name, c->Template_Name);
+                c->Template_Name[0] = 0x0;
+            }
+            else
+                req.Type = PIPE_MSG_INSTRUCTION;
+
+            queue_request(c, &req, c->Buf, c->Len);
+
+            // reset index instructions
+            c->Len = 0;
+        }
+    }
+
+    if (c->Len > 0) {
+
+        // let remote know more data is needed
+        Debug("request for more data\n");
+        sent_to_pipe(c, c->Serial, "<<MORE>>");
+    }
+
+    return(n);
+}
+
+/**
+ * @brief read and parse and communicate with remote programs
+ *
+ * The named pipes (-P) and the remote programs on the socket (-S) are
+ * read as data arrives, each with its own buffers. Complete requests
+ * go in one render queue and are performed in the order they arrived.
+ * With -A the render thread performs them while this thread reads on,
+ * and a panel thread displays the frames (see queue_panel()).
+ *
+ * With an idle window (-i) the display stays awake after a request and
+ * goes to deep sleep when no request arrived within the window.
+ *
+ * Next to instructions the remote program can sent :
+ * <<NEW>>              start all over
+ * <<CLOSE>>            close down
+ * <<TEMPLATE name>>    the next instruction is template name
+ * <<RENDER name var=value;var=value>>  draw template name
+ * <<FRAMED>>           framed messages from now on (see pipe_msg.h)
+ *
+ * @param pipes : also read from the named pipes
+ */
+void Comm_Over_Pipe(bool pipes)
+{
+    struct epoll_event ev[MAXCLIENTS + 2];
     char buf[BUFSIZE];     // received command from remote
-    char ret_buf[20];      // sent to program
+    CLIENT *c;
+    int  i, m, n, nev;
+
+    // no pipes or socket clients yet
+    for (i = 0; i <= MAXCLIENTS; i++)
+        Clients[i].Fd_r = Clients[i].Fd_w = -1;
+
+    if ((ep_fd = epoll_create1(0)) < 0) {
+        printf("can not create epoll handle\n");
+        close_out(EXIT_FAILURE);
+    }
+
+    // connect read and write pipe
+    if (pipes) connect_pipes();
+
+    if (name_socket[0] != 0x0) open_socket();
+
+    // the display is awake after hw_init() in main()
+    panel_idle();
+
+    if (Async) {
+        if ((close_fd = eventfd(0, 0)) < 0) {
+            printf("can not create eventfd\n");
+            close_out(EXIT_FAILURE);
+        }
+        watch_fd(close_fd, &close_fd);
+
+        start_threads();
+    }
 
-    i = 0;
-    
-    memset(Instruction, 0x0, MAXINSTRUCTIONS);
-    
     while(1)
     {
         printf("EPD server: wait input from remote program\n");
 
-        n = read(p_fd_r, buf, BUFSIZE);
-      
-        // Any input ?
-        if (n > 0)
-        {
-            // terminate received buffer
-            buf[n] = 0x0;
+        // with -A the panel thread sets the display to deep sleep
+        nev = epoll_wait(ep_fd, ev, MAXCLIENTS + 2, Async ? -1 : idle_timeout());
+
+        if (nev < 0) {
+            if (errno == EINTR) continue;
+            printf("Error during waiting for input\n");
+            close_out(EXIT_FAILURE);
+        }
+
+        // no request within the idle window
+        if (nev == 0) {
+            Debug("no request for %d seconds\n", Idle_Sleep);
+            panel_sleep();
+            continue;
+        }
 
-            Debug("received %s, with length %d\n", buf, n);
+        for (i = 0; i < nev; i++) {
 
-            // check for instruction to start all over
-            if (strstr(buf,"<<NEW>>") != NULL) {
-                i = 0;
+            // new remote program on the socket
+            if ((c = ev[i].data.ptr) == NULL) {
+                accept_client();
                 continue;
             }
-            
-            // check for instruction to close down
-            if (strstr(buf,"<<CLOSE>>") != NULL) {
-                close_out(EXIT_SUCCESS);
-            }
 
-            // parse incoming EPD instruction   
-            for (j = 0; j < n; j++) {
-                
-                if (i == MAXINSTRUCTIONS) {
-                    Instruction[i] = 0x0;
-                    printf("Too many instructions for buffer : %s\n", Instruction);
-                    if (sent_to_pipe("<<OVERRUN>>") == -1)
-                        close_out(EXIT_FAILURE);
-                }
-                
-                Instruction[i++] = buf[j];
-             
-                // check for last character
-                if (buf[j] == '>') {
-                    
-                    // let remote know execution is starting
-                    if (sent_to_pipe("<<START>>") == -1)
-                        close_out(EXIT_FAILURE);                   
-                    
-                    // set hardware and EPD correct
-                    hw_init();
-                    
-                    Debug("Pipe got instruct %s\n", Instruction);                   
-                    
-                    // execute received instruction
-                    ret = parse_string_instruction();
-                   
-                    // set EPD to deepsleep
-                    if (EPD_DisplayOn) {
-                        EPD_Sleep();
-                        EPD_DisplayOn = false;
-                    }
-                    
-                    // check for result
-                    if (ret == 0) {
-                        Debug("execution succesfull\n");
-                        sprintf(ret_buf, "<<OK>>");
-                    }
-                    else {
-                        Debug("Error during execution : %s\n", Instruction);
-                        sprintf(ret_buf, "<<ERROR%d>>",ret);
-                    }
-                    
-                    if (sent_to_pipe(ret_buf) == -1)
-                        close_out(EXIT_FAILURE);
-                   
-                    // reset index instructions
-                    i=0;
-                    
-                    // indicate we got all and break
-                    j=n+2;
-                    
-                    // reset buffers
-                    memset(Instruction, 0x0, MAXINSTRUCTIONS);
-                                        
-                    break;
-                }
-            }
-            
-            if( j != n+2) {
-                
-                // let remote know more data is needed
-                Debug("request for more data\n");
-                if (sent_to_pipe("<<MORE>>") == -1)  close_out(EXIT_FAILURE);
+            // <<CLOSE>> after the frames before it (-A)
+            if (ev[i].data.ptr == &close_fd) close_out(EXIT_SUCCESS);
+
+            if (c->Failed) continue;
+
+            n = read(c->Fd_r, buf, BUFSIZE - 1);
+
+            // Any input ?
+            if (n > 0)
+            {
+                // terminate received buffer
+                buf[n] = 0x0;
+
+                for (m = 0; m < n; )
+                    m += c->Framed ? framed_input(c, buf + m, n - m) : text_input(c, buf + m, n - m);
             }
+
+            // client has gone or connection lost
+            else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+                c->Failed = true;
         }
-        
-        else if (n < 0)
-        {
-            printf("lost connection ? Closing pipes and try to reconnect");
-            
-            // reinit... as pipe connection seems to have been lost
-            close(p_fd_r);
-            close(p_fd_w);
-            
-            // reset filedescriptors
-            p_fd_r = p_fd_w = -1;
-            
-            // reset offset instruction
-            i=0;
-            
-            connect_pipes();
-        }
-        
+
+        for (i = 0; i <= MAXCLIENTS; i++)
+            if (Clients[i].Fd_r >= 0 && Clients[i].Failed) close_client(&Clients[i]);
+
+        // all that was received is read, now perform it
+        if (! Async) run_queue();
+
     } // while
 }
 
@@ -1514,11 +3422,15 @@ int main(int argc, char *argv[])
 
     init_variables();
     
-    while ((opt = getopt(argc, argv, "dhHF:T:Pr:w:")) != -1) {
+    while ((opt = getopt(argc, argv, "dhHF:T:Pr:w:S:ALi:W:b:uf:E:t:")) != -1) {
         
         switch(opt){
             case 'F':           // read instruction from file
-                read_from_file(optarg);
+                read_from_file(optarg, Instruction);
+                break;
+            
+            case 't':           // template from file
+                define_file_template(optarg);
                 break;
             
             case 'T':           // instruction on the command line
@@ -1537,6 +3449,23 @@ int main(int argc, char *argv[])
               strncpy(name_pipe_w, optarg,MAXFILENAME);
               break;
 
+            case 'S':           // unix socket to listen on
+              strncpy(name_socket, optarg,MAXFILENAME - 1);
+              break;
+
+            case 'A':           // asynchronous render and panel threads
+              Async = true;
+              break;
+            
+            case 'L':           // latest frame wins (-A)
+              Latest_Wins = true;
+              break;
+            
+            case 'i':           // idle window before deep sleep
+              Idle_Sleep = (int) strtol(optarg, NULL, 10);
+              if (Idle_Sleep < 0) Idle_Sleep = 0;
+              break;
+
             case 'h':           // display help
             case 'H':
                 usage();
@@ -1548,6 +3477,29 @@ int main(int argc, char *argv[])
                 // enable debug messages
                 Set_Debug(1);
                 break;
+            
+            case 'W':           // wait for busy display
+                set_wait_mode(optarg);
+                break;
+            
+            case 'b':           // hardware backend
+                if (DEV_Set_Backend(optarg)) {
+                    p_printf(D_RED, "unknown backend %s\n", optarg);
+                    close_out(EXIT_FAILURE);
+                }
+                break;
+            
+            case 'u':           // partial update
+                Partial_Update = true;
+                break;
+            
+            case 'f':           // directory with binary font files
+                Font_SetDir(optarg);
+                break;
+            
+            case 'E':           // write binary font file
+                close_out(export_font(optarg) ? EXIT_FAILURE : EXIT_SUCCESS);
+                break;
                                         
             default:
                 p_printf(D_RED, "unknown option %c, 0x%x\n", opt,opt);
@@ -1556,7 +3508,7 @@ int main(int argc, char *argv[])
         }
     }
  
-    if (geteuid() != 0)  {
+    if (DEV_Need_Root() && geteuid() != 0)  {
         p_printf(RED,(char *) "You must be super user\n");
         exit(EXIT_FAILURE);
     }  
@@ -1567,7 +3519,7 @@ int main(int argc, char *argv[])
     // create in memory IMAGE
     image_init();
     
-    if (Pipe_Comm) Comm_Over_Pipe();
+    if (Pipe_Comm || name_socket[0] != 0x0) Comm_Over_Pipe(Pipe_Comm);
     
     // parse command string
     else parse_string_instruction();
@@ -1593,53 +3545,58 @@ based on the original Paint_DrawChar, but now support colors in a single line
 void ePaint_DrawChar(UWORD Xpoint, UWORD Ypoint, const char Acsii_Char,
                     sFONT* Font, UWORD Color_Background, UWORD Color_Foreground)
 {
-    UWORD Page, Column;
+    UWORD Page, Column, Width, i;
+    UWORD Width_Byte = Font->Width / 8 + (Font->Width % 8 ? 1 : 0);
+    uint64_t Row, Fill;
 
     if (Xpoint > Paint.Width || Ypoint > Paint.Height) {
         printf("Paint_DrawChar Input exceeds the normal display range\r\n");
         return;
     }
 
-    uint32_t Char_Offset = (Acsii_Char - ' ') * Font->Height * (Font->Width / 8 + (Font->Width % 8 ? 1 : 0));
+    // the font has the glyphs for ' ' to '~' (a value can have any byte)
+    if (Acsii_Char < ' ' || Acsii_Char > '~') {
+        Debug("no glyph for character 0x%02x\n", (UBYTE) Acsii_Char);
+        return;
+    }
+
+    uint32_t Char_Offset= (Acsii_Char - ' ') * Font->Height * Width_Byte;
     const unsigned char *ptr = &Font->table[Char_Offset];
 
-    for (Page = 0; Page < Font->Height; Page ++ ) {
+    // rotated or mirrored: through the glyph cache
+    if (Paint_DrawGlyph(Xpoint, Ypoint, ptr, Font->Width, Font->Height,
+        Color_Foreground == COLOR ? RedImage : BlackImage, Color_Foreground == COLOR ? RED : Color_Foreground,
+        Color_Background == COLOR ? RedImage : BlackImage, Color_Background == COLOR ? RED : Color_Background) == 0)
+        return;
+
+    for (Page = 0; Page < Font->Height; Page ++, ptr += Width_Byte) {
         
-        for (Column = 0; Column < Font->Width; Column ++ ) {
-        // add color display to the DrawChar
-            if (*ptr & (0x80 >> (Column % 8))) {
-                
-                 if (Color_Foreground == COLOR) {
-                    Paint_SelectImage(RedImage);
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, RED);
-                    Paint_SelectImage(BlackImage);
-                }
-                else {
-                    Paint_SelectImage(BlackImage);
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, Color_Foreground);
-                }
-            } 
-                
-            else {
-                
-                if (Color_Background == COLOR) {
-                    Paint_SelectImage(RedImage);
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, RED);
-                    Paint_SelectImage(BlackImage);
-                }
-                else  {
-                    Paint_SelectImage(BlackImage);
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, Color_Background);
-                }                       
-            }
+        // a font line is written in parts of 64 pixels (8 bytes)
+        for (Column = 0; Column < Font->Width; Column += 64) {
             
-            //One pixel is 8 bits
-            if (Column % 8 == 7)
-                ptr++;
+            Width = Font->Width - Column;
+            if (Width > 64) Width = 64;
+            
+            Row = 0;
+            for (i = 0; i < (Width + 7) / 8; i++)
+                Row |= (uint64_t) ptr[Column / 8 + i] << (56 - 8 * i);
+            
+            Fill = (Width < 64) ? ~(~(uint64_t) 0 >> Width) : ~(uint64_t) 0;
+            
+            // add color display to the DrawChar
+            if (Color_Foreground == COLOR)
+                Paint_DrawRowBits(RedImage, Xpoint + Column, Ypoint + Page, Row & Fill, Width, RED);
+            else
+                Paint_DrawRowBits(BlackImage, Xpoint + Column, Ypoint + Page, Row & Fill, Width, Color_Foreground);
+            
+            if (Color_Background == COLOR)
+                Paint_DrawRowBits(RedImage, Xpoint + Column, Ypoint + Page, ~Row & Fill, Width, RED);
+            else
+                Paint_DrawRowBits(BlackImage, Xpoint + Column, Ypoint + Page, ~Row & Fill, Width, Color_Background);
         }// Write a line
-        if (Font->Width % 8 != 0)
-            ptr++;
     }// Write all
+    
+    Paint_SelectImage(BlackImage);
 }
 
 /******************************************************************************
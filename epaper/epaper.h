@@ -34,33 +34,146 @@
 # include <getopt.h>     // parse command line
 # include <sys/stat.h>   // open call
 # include <fcntl.h>      // open call
+# include <ctype.h>      // isalnum()
+# include <errno.h>
+# include <sys/epoll.h>  // wait for pipes and socket clients
+# include <sys/socket.h> // unix socket
+# include <sys/un.h>
+# include <sys/eventfd.h> // panel thread asks to close down (-A)
+# include <pthread.h>    // asynchronous render and panel threads (-A)
 
 #include "./obj/GUI_Paint.h"
+#include "./obj/GUI_Fonts.h"
 #include "./obj/GUI_BMPfile.h"
+#include "./obj/GUI_Dither.h"
 #include "./obj/ImageData.h"
 #include "./obj/EPD_7in5b.h"
+#include "./obj/EPD_Frame.h"
+#include "./pipe_msg.h"
 
-#define FONTLOCATION "./Fonts/" // directory where fonts are stored
-#define FONTLENGTH 15           // maximum length name font
 #define MAXTEXTLENGTH 200       // maximum length text as part of instructions
 #define MAXINSTRUCTIONS 1000    // maximum length epaper instructions
 #define MAXFILENAME 100         // maximum length file or pipename
+#define PARTIAL_MAX 50          // maximum % of the display for a partial update
 
 // next to BLACK and WHITE also define COLOR
 #define COLOR 4
 
 struct image_prop {
-    char  font[FONTLENGTH];
+    const FONT_ENTRY *font;
     UWORD Xstart;
     UWORD Ystart;
     UWORD front_color;
     UWORD back_color;
     UWORD Xstart_back;
     UWORD Ystart_back;
+    UBYTE dither;
 };
 
 /**
- * Enhanced versions of the draw to support color display
+ * An instruction string is compiled once into a display list, a list
+ * of ops with the numbers, fonts and text already parsed
+ */
+#define DL_CACHE 8                      // display lists kept
+#define DL_OPS (MAXINSTRUCTIONS / 3)    // maximum ops ("x=y") in an instruction
+
+typedef struct {
+    char Code;                  // instruction (f, p, t, l, ...)
+    char Option;                // single character (B=, T=, D=, !=)
+    UWORD Value[4];             // position, color, size, ...
+    UBYTE Var[4];               // template variable + 1 instead of Value
+    const FONT_ENTRY *Font;     // f=
+    const char *Text;           // text or filename
+    bool Text_Vars;             // Text has template variables (DL_VAR)
+} DL_OP;
+
+typedef struct {
+    uint64_t Hash;              // hash of Source
+    UDOUBLE Used;               // last use, 0 = free
+    UWORD Count;                // number of ops
+    bool Display;               // display the images after the ops
+    char *Source;               // instruction that was compiled
+    DL_OP *Op;
+} DISPLAY_LIST;
+
+/**
+ * A template is a display list with variables {name}, drawn with the
+ * values given in a RENDER message
+ */
+#define TPL_MAX 16                      // templates kept
+#define TPL_NAME 16                     // maximum length template or variable name
+#define TPL_VARS 16                     // maximum variables in a template
+#define DL_VAR 0x01                     // variable in a text, followed by its number + 1
+
+typedef struct {
+    char Name[TPL_NAME];
+    char Var[TPL_VARS][TPL_NAME];       // variable names
+    UBYTE Vars;                         // number of variables
+    DISPLAY_LIST List;
+} TEMPLATE;
+
+/**
+ * A remote program on the named pipes or the unix socket, with its own
+ * receive buffers. Complete requests of all clients go in one render
+ * queue and are performed in the order they arrived. With -A a thread
+ * draws them, a second thread sends the frames to the panel (panel queue)
+ */
+#define MAXCLIENTS 8                    // socket clients, next to the named pipes
+#define RQ_MAX 32                       // requests waiting in the render queue
+#define PQ_MAX 2                        // frames waiting for the panel (-A)
+#define PQ_COALESCE RQ_MAX              // requests one waiting frame can replace (-L)
+
+typedef struct {
+    int Fd_r;                           // read handle, -1 = not connected
+    int Fd_w;                           // write handle
+    UDOUBLE Serial;                     // connection number, a result for an
+                                        // earlier connection is not sent
+    bool Failed;                        // read or write failed, close it
+    char Buf[MAXINSTRUCTIONS];          // text instruction being received
+    int Len;                            // bytes in Buf
+    char Template_Name[TPL_NAME];       // next instruction is this template
+    bool Framed;                        // framed messages (pipe_msg.h)
+    UBYTE Msg[PIPE_MSG_HEADER + MAXINSTRUCTIONS];  // framed message being received
+    int Msg_Len;                        // bytes in Msg
+    int Msg_Skip;                       // bytes to skip of a too long message
+} CLIENT;
+
+typedef struct {
+    CLIENT *Client;                     // client that sent the request
+    UDOUBLE Serial;                     // connection of the client
+    UBYTE Type;                         // PIPE_MSG_xxx, PIPE_MSG_REPLY = result only
+    bool Framed;                        // sent a framed reply
+    uint32_t Id;                        // id of the framed message
+    int Ret;                            // result of a PIPE_MSG_REPLY
+    char Name[TPL_NAME];                // template name
+    char *Data;                         // instruction or values
+} RENDER_REQ;
+
+/**
+ * A frame to send to the display, see display_image()
+ */
+typedef struct {
+    UBYTE *Black;                       // images
+    UBYTE *Red;
+    uint64_t Hash;                      // EPD_FrameHash() of the images
+    const UBYTE *Packed;                // packed frame if known, else NULL
+    bool Dirty;                         // the area changed since the last frame is known
+    UWORD Xstart, Ystart, Xend, Yend;   // changed area
+} DISPLAY_FRAME;
+
+typedef struct {
+    RENDER_REQ Req;                     // request to sent the result to
+    int Ret;                            // result of the request
+    bool Display;                       // display Frame
+    DISPLAY_FRAME Frame;                // Black and Red point to the copies below
+    UBYTE *Black;                       // copy of the images (EPD_PLANE_BYTES)
+    UBYTE *Red;
+    RENDER_REQ Coalesced[PQ_COALESCE];  // earlier requests, their frame was replaced (-L)
+    int Num_Coalesced;
+} PANEL_JOB;
+
+/**
+ * Enhanced versions of the drawto support color display
  * The rest is the same as the original versions
  */
 void ePaint_DrawChar(UWORD Xpoint, UWORD Ypoint, const char Acsii_Char,
@@ -25,6 +25,13 @@
 *   #define DEV_Digital_Write(_pin, _value) bcm2835_gpio_write(_pin, _value)
 *   #define DEV_Digital_Read(_pin) bcm2835_gpio_lev(_pin)
 *   #define DEV_SPI_WriteByte(__value) bcm2835_spi_transfer(__value)
+* 5.add: (agent)
+*   DEV_Wait_Edge() sleep until a pin goes high using gpiochip line events
+*   DEV_Time_ms() monotonic time in ms
+* 6.Change: (agent)
+*   The DEV_xxx macros call the selected hardware backend (DEV_Set_Backend).
+*   The bcm2835 backend is in this file, linux spidev/gpiochip in DEV_Linux.c
+*   and the simulated panel in DEV_Sim.c
 #
 # Permission is hereby granted, free of charge, to any person obtaining a copy
 # of this software and associated documnetation files (the "Software"), to deal
@@ -45,11 +52,113 @@
 # THE SOFTWARE.
 #
 ******************************************************************************/
+#define _POSIX_C_SOURCE 200809L  // clock_gettime()
 #include "DEV_Config.h"
 # include <stdarg.h>    // for debug
 # include <stdlib.h>     // for debug()
 # include <string.h>     // for debug()
+# include <strings.h>    // strncasecmp()
+# include <time.h>       // clock_gettime()
+
+/* selected backend */
+const DEV_BACKEND *DEV_Backend = &DEV_BACKEND_DFT;
+
+/* option after the backend name (e.g. sim:frame.ppm) */
+static char DEV_Backend_Option[100] = "";
+
+/* available backends */
+static const DEV_BACKEND *DEV_Backends[] = {
+#ifndef NO_BCM2835
+    &DEV_Backend_BCM2835,
+#endif
+    &DEV_Backend_Linux,
+    &DEV_Backend_Sim,
+    NULL
+};
+
+/******************************************************************************
+function:       Select the hardware backend
+parameter:
+    Name :      backend name, optional followed by :option
+Info:
+    Must be called before DEV_ModuleInit()
+    return 0 = OK, 1 = unknown backend
+******************************************************************************/
+UBYTE DEV_Set_Backend(const char *Name)
+{
+    const char *Option = strchr(Name, ':');
+    size_t Len = Option ? (size_t) (Option - Name) : strlen(Name);
+    UBYTE i;
+
+    for (i = 0; DEV_Backends[i] != NULL; i++) {
+
+        if (strlen(DEV_Backends[i]->Name) == Len &&
+            strncasecmp(DEV_Backends[i]->Name, Name, Len) == 0) {
+
+            DEV_Backend = DEV_Backends[i];
+
+            if (Option) {
+                strncpy(DEV_Backend_Option, Option + 1, sizeof(DEV_Backend_Option) - 1);
+                DEV_Backend_Option[sizeof(DEV_Backend_Option) - 1] = 0x0;
+            }
+            else
+                DEV_Backend_Option[0] = 0x0;
+
+            Debug("backend set to %s\n", DEV_Backend->Name);
+            return 0;
+        }
+    }
+
+    return 1;
+}
 
+/******************************************************************************
+function:       Check whether the selected backend needs root
+parameter:
+Info:           return 1 = root needed
+******************************************************************************/
+UBYTE DEV_Need_Root(void)
+{
+    return DEV_Backend->NeedRoot;
+}
+
+/******************************************************************************
+function:       Module Initialize the selected backend
+parameter:
+Info:           return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE DEV_ModuleInit(void)
+{
+    return DEV_Backend->ModuleInit(DEV_Backend_Option);
+}
+
+/******************************************************************************
+function:       Module exits the selected backend
+parameter:
+Info:
+******************************************************************************/
+void DEV_ModuleExit(void)
+{
+    DEV_Backend->ModuleExit();
+}
+
+/******************************************************************************
+function:       Monotonic time
+parameter:
+Info:           return milliseconds since an arbitrary starting point
+                (wraps after 49 days, use the difference of two times)
+******************************************************************************/
+UDOUBLE DEV_Monotonic_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    // tv_sec * 1000 overflows a 32 bit time_t after 24.8 days
+    return (UDOUBLE) ((uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+#ifndef NO_BCM2835
 /******************************************************************************
 function:       Initialization pin
 parameter:
@@ -72,7 +181,7 @@ function:       Module Initialize, the BCM2835 library and initialize the pins,
 parameter:
 Info:
 ******************************************************************************/
-UBYTE DEV_ModuleInit(void)
+static UBYTE BCM_ModuleInit(const char *Option)
 {
     if(!bcm2835_init()) {
         printf("bcm2835 init failed  !!! \r\n");
@@ -98,12 +207,55 @@ function:       Module exits, closes SPI and BCM2835 library
 parameter:
 Info:
 ******************************************************************************/
-void DEV_ModuleExit(void)
+static void BCM_ModuleExit(void)
 {
+    DEV_Linux_Edge_Close();
+
     bcm2835_spi_end();
     bcm2835_close();
 }
 
+/******************************************************************************
+function:       GPIO, SPI and delay through the BCM2835 library
+parameter:
+Info:
+******************************************************************************/
+static void BCM_Digital_Write(UWORD Pin, UBYTE Value)
+{
+    bcm2835_gpio_write(Pin, Value);
+}
+
+static UBYTE BCM_Digital_Read(UWORD Pin)
+{
+    return bcm2835_gpio_lev(Pin);
+}
+
+static void BCM_SPI_WriteByte(UBYTE Value)
+{
+    bcm2835_spi_transfer(Value);
+}
+
+static void BCM_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+    bcm2835_spi_writenb((char *) pData, Len);
+}
+
+static void BCM_Delay_ms(UDOUBLE xms)
+{
+    bcm2835_delay(xms);
+}
+
+const DEV_BACKEND DEV_Backend_BCM2835 = {
+    "bcm2835", 1,
+    BCM_ModuleInit, BCM_ModuleExit,
+    BCM_Digital_Write, BCM_Digital_Read,
+    BCM_SPI_WriteByte, BCM_SPI_Write_nByte,
+    BCM_Delay_ms,
+    DEV_Linux_Wait_Edge,            // edge events from the gpiochip driver
+    DEV_Monotonic_ms
+};
+#endif // NO_BCM2835
+
 /******************************************************************************
 function:       enable / disableDebug messages
 parameter:
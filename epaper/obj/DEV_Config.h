@@ -49,7 +49,9 @@
 #define _DEV_CONFIG_H_
 
 #include <sys/types.h>		// added to overcome off_t not defined in bcm2835.h
+#ifndef NO_BCM2835
 #include <bcm2835.h>
+#endif
 #include <stdint.h>
 #include <stdio.h>
 
@@ -68,27 +70,84 @@
 #define EPD_CS_PIN      8
 #define EPD_BUSY_PIN    24
 
+/**
+ * Hardware backend
+ * 
+ * bcm2835 : BCM2835 library (needs root)
+ * linux   : kernel spidev and gpiochip drivers
+ * sim     : simulated panel, no hardware needed
+**/
+typedef struct {
+    const char *Name;
+    UBYTE NeedRoot;                                         // 1 = must run as root
+    UBYTE (*ModuleInit)(const char *Option);                // 0 = OK, 1 = error
+    void (*ModuleExit)(void);
+    void (*Digital_Write)(UWORD Pin, UBYTE Value);
+    UBYTE (*Digital_Read)(UWORD Pin);
+    void (*SPI_WriteByte)(UBYTE Value);
+    void (*SPI_Write_nByte)(UBYTE *pData, UDOUBLE Len);
+    void (*Delay_ms)(UDOUBLE xms);
+    UBYTE (*Wait_Edge)(UWORD Pin, UDOUBLE Timeout_ms);      // DEV_WAIT_xxx
+    UDOUBLE (*Time_ms)(void);
+} DEV_BACKEND;
+
+extern const DEV_BACKEND *DEV_Backend;
+extern const DEV_BACKEND DEV_Backend_BCM2835;
+extern const DEV_BACKEND DEV_Backend_Linux;
+extern const DEV_BACKEND DEV_Backend_Sim;
+
+#ifdef NO_BCM2835
+#define DEV_BACKEND_DFT     DEV_Backend_Linux
+#else
+#define DEV_BACKEND_DFT     DEV_Backend_BCM2835
+#endif
+
 /**
  * GPIO read and write
 **/
-#define DEV_Digital_Write(_pin, _value) bcm2835_gpio_write(_pin, _value)
-#define DEV_Digital_Read(_pin) bcm2835_gpio_lev(_pin)
+#define DEV_Digital_Write(_pin, _value) DEV_Backend->Digital_Write(_pin, _value)
+#define DEV_Digital_Read(_pin) DEV_Backend->Digital_Read(_pin)
 
 /**
  * SPI
 **/
-#define DEV_SPI_WriteByte(__value) bcm2835_spi_transfer(__value)
+#define DEV_SPI_WriteByte(__value) DEV_Backend->SPI_WriteByte(__value)
+#define DEV_SPI_Write_nByte(__pData, __len) DEV_Backend->SPI_Write_nByte(__pData, __len)
 
 /**
  * delay x ms
 **/
-#define DEV_Delay_ms(__xms) bcm2835_delay(__xms)
+#define DEV_Delay_ms(__xms) DEV_Backend->Delay_ms(__xms)
+
+/**
+ * GPIO edge wait and time
+**/
+#define DEV_Wait_Edge(_pin, _timeout) DEV_Backend->Wait_Edge(_pin, _timeout)
+#define DEV_Time_ms() DEV_Backend->Time_ms()
+
+#define DEV_WAIT_OK         0       // pin is high
+#define DEV_WAIT_TIMEOUT    1       // pin still low after timeout
+#define DEV_WAIT_NOEDGE     2       // edge detection not available
+
+/**
+ * linux gpiochip / spidev
+**/
+#define DEV_GPIOCHIP    "/dev/gpiochip0"
+#define DEV_SPIDEV      "/dev/spidev0.0"
+#define DEV_SPI_SPEED   1953125     // same as BCM2835_SPI_CLOCK_DIVIDER_128
 
 /*------------------------------------------------------------------------------------------------------*/
+UBYTE DEV_Set_Backend(const char *Name);
+UBYTE DEV_Need_Root(void);
 UBYTE DEV_ModuleInit(void);
 void DEV_ModuleExit(void);
+UDOUBLE DEV_Monotonic_ms(void);
 void Set_Debug(int level);
 void Debug(char *format, ...);
 
+// shared by the bcm2835 and linux backend (DEV_Linux.c)
+UBYTE DEV_Linux_Wait_Edge(UWORD Pin, UDOUBLE Timeout_ms);
+UBYTE DEV_Linux_Edge_Read(UWORD Pin, UBYTE *Value);
+void DEV_Linux_Edge_Close(void);
 
 #endif
@@ -0,0 +1,340 @@
+/*****************************************************************************
+* | File        :   DEV_Linux.c
+* | Author      :   agent
+* | Function    :   Hardware backend on the linux spidev and gpiochip drivers
+* | Info        :
+*                Does not need the BCM2835 library or direct access to the
+*                peripherals. The SPI chip select (CE0) is driven by the
+*                spidev driver, writes to EPD_CS_PIN are ignored.
+*                The gpiochip edge functions are used by the bcm2835 backend
+*                as well to wait for the busy pin.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#define _POSIX_C_SOURCE 200809L  // nanosleep()
+#include "DEV_Config.h"
+# include <stdlib.h>
+# include <string.h>
+# include <time.h>       // nanosleep()
+# include <fcntl.h>      // open()
+# include <unistd.h>     // close()
+# include <poll.h>       // poll()
+# include <sys/ioctl.h>  // ioctl()
+# include <linux/gpio.h> // gpiochip
+# include <linux/spi/spidev.h>
+
+#define SPI_CHUNK   4096        // default spidev buffer size
+
+/* line event handle as obtained in DEV_Linux_Edge_Request() */
+static int  Edge_fd = -1;
+static UWORD Edge_Pin = 0xffff;
+static UBYTE Edge_Failed = 0;
+
+/* output line handles */
+static int  Rst_fd = -1;
+static int  Dc_fd = -1;
+
+/* spidev handle */
+static int  Spi_fd = -1;
+
+/******************************************************************************
+function:       Request rising edge events for a pin from the gpiochip
+parameter:
+    Pin :       BCM GPIO number (= line offset on gpiochip0)
+Info:
+    The request is kept open for the next waits on the same pin
+    return 0 = OK, 1 = error
+******************************************************************************/
+static UBYTE DEV_Linux_Edge_Request(UWORD Pin)
+{
+    struct gpioevent_request req;
+    int fd;
+
+    if (Edge_fd >= 0 && Edge_Pin == Pin) return 0;
+
+    DEV_Linux_Edge_Close();
+
+    if ((fd = open(DEV_GPIOCHIP, O_RDONLY)) < 0) {
+        Debug("can not open %s\n", DEV_GPIOCHIP);
+        return 1;
+    }
+
+    memset(&req, 0x0, sizeof(req));
+    req.lineoffset = Pin;
+    req.handleflags = GPIOHANDLE_REQUEST_INPUT;
+    req.eventflags = GPIOEVENT_REQUEST_RISING_EDGE;
+    strncpy(req.consumer_label, "epaper-busy", sizeof(req.consumer_label) - 1);
+
+    if (ioctl(fd, GPIO_GET_LINEEVENT_IOCTL, &req) < 0) {
+        Debug("can not request edge events for GPIO %d\n", Pin);
+        close(fd);
+        return 1;
+    }
+
+    close(fd);
+    Edge_fd = req.fd;
+    Edge_Pin = Pin;
+    return 0;
+}
+
+/******************************************************************************
+function:       Release the edge event request
+parameter:
+Info:
+******************************************************************************/
+void DEV_Linux_Edge_Close(void)
+{
+    if (Edge_fd >= 0) {
+        close(Edge_fd);
+        Edge_fd = -1;
+        Edge_Pin = 0xffff;
+    }
+}
+
+/******************************************************************************
+function:       Read the level of a pin requested for edge events
+parameter:
+    Pin   :     BCM GPIO number
+    Value :     receives the level
+Info:           return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE DEV_Linux_Edge_Read(UWORD Pin, UBYTE *Value)
+{
+    struct gpiohandle_data data;
+
+    if (DEV_Linux_Edge_Request(Pin)) return 1;
+
+    if (ioctl(Edge_fd, GPIOHANDLE_GET_LINE_VALUES_IOCTL, &data) < 0) return 1;
+
+    *Value = data.values[0];
+    return 0;
+}
+
+/******************************************************************************
+function:       Sleep until a pin goes high
+parameter:
+    Pin        : BCM GPIO number
+    Timeout_ms : maximum time to wait
+Info:
+    The caller is not scheduled while waiting. An edge that happened before
+    the request is caught by reading the level first.
+    return DEV_WAIT_OK, DEV_WAIT_TIMEOUT or DEV_WAIT_NOEDGE
+******************************************************************************/
+UBYTE DEV_Linux_Wait_Edge(UWORD Pin, UDOUBLE Timeout_ms)
+{
+    struct gpioevent_data event;
+    struct pollfd pfd;
+    UBYTE Value;
+
+    if (Edge_Failed) return DEV_WAIT_NOEDGE;
+
+    if (DEV_Linux_Edge_Read(Pin, &Value)) {
+        Edge_Failed = 1;
+        return DEV_WAIT_NOEDGE;
+    }
+
+    if (Value) return DEV_WAIT_OK;
+
+    pfd.fd = Edge_fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, (int) Timeout_ms) <= 0) return DEV_WAIT_TIMEOUT;
+
+    // consume the event
+    if (read(Edge_fd, &event, sizeof(event)) != sizeof(event))
+        return DEV_WAIT_TIMEOUT;
+
+    return DEV_WAIT_OK;
+}
+
+/******************************************************************************
+function:       Request a pin as output from the gpiochip
+parameter:
+    chip :      gpiochip handle
+    Pin  :      BCM GPIO number
+Info:           return line handle or -1 on error
+******************************************************************************/
+static int Linux_Request_Output(int chip, UWORD Pin)
+{
+    struct gpiohandle_request req;
+
+    memset(&req, 0x0, sizeof(req));
+    req.lineoffsets[0] = Pin;
+    req.lines = 1;
+    req.flags = GPIOHANDLE_REQUEST_OUTPUT;
+    req.default_values[0] = 1;
+    strncpy(req.consumer_label, "epaper", sizeof(req.consumer_label) - 1);
+
+    if (ioctl(chip, GPIO_GET_LINEHANDLE_IOCTL, &req) < 0) {
+        printf("can not request GPIO %d as output\r\n", Pin);
+        return -1;
+    }
+
+    return req.fd;
+}
+
+/******************************************************************************
+function:       Module exits, release lines and spidev
+parameter:
+Info:
+******************************************************************************/
+static void Linux_ModuleExit(void)
+{
+    DEV_Linux_Edge_Close();
+
+    if (Rst_fd >= 0) close(Rst_fd);
+    if (Dc_fd >= 0) close(Dc_fd);
+    if (Spi_fd >= 0) close(Spi_fd);
+
+    Rst_fd = Dc_fd = Spi_fd = -1;
+}
+
+/******************************************************************************
+function:       Module Initialize, open spidev and request the pins
+parameter:
+    Option :    optional spidev device (default DEV_SPIDEV)
+Info:           return 0 = OK, 1 = error
+******************************************************************************/
+static UBYTE Linux_ModuleInit(const char *Option)
+{
+    const char *Spidev = (Option && *Option) ? Option : DEV_SPIDEV;
+    UBYTE Mode = SPI_MODE_0, Bits = 8;
+    UDOUBLE Speed = DEV_SPI_SPEED;
+    int chip;
+
+    if ((chip = open(DEV_GPIOCHIP, O_RDONLY)) < 0) {
+        printf("can not open %s\r\n", DEV_GPIOCHIP);
+        return 1;
+    }
+
+    Rst_fd = Linux_Request_Output(chip, EPD_RST_PIN);
+    Dc_fd = Linux_Request_Output(chip, EPD_DC_PIN);
+    close(chip);
+
+    if (Rst_fd < 0 || Dc_fd < 0) {
+        Linux_ModuleExit();
+        return 1;
+    }
+
+    if ((Spi_fd = open(Spidev, O_RDWR)) < 0) {
+        printf("can not open %s\r\n", Spidev);
+        Linux_ModuleExit();
+        return 1;
+    }
+
+    if (ioctl(Spi_fd, SPI_IOC_WR_MODE, &Mode) < 0 ||
+        ioctl(Spi_fd, SPI_IOC_WR_BITS_PER_WORD, &Bits) < 0 ||
+        ioctl(Spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &Speed) < 0) {
+        printf("can not set up %s\r\n", Spidev);
+        Linux_ModuleExit();
+        return 1;
+    }
+
+    printf("linux spidev/gpiochip init success !!! \r\n");
+    return 0;
+}
+
+/******************************************************************************
+function:       GPIO through gpiochip line handles
+parameter:
+Info:
+******************************************************************************/
+static void Linux_Digital_Write(UWORD Pin, UBYTE Value)
+{
+    struct gpiohandle_data data;
+    int fd;
+
+    if (Pin == EPD_RST_PIN) fd = Rst_fd;
+    else if (Pin == EPD_DC_PIN) fd = Dc_fd;
+    else return;                            // CS is handled by spidev
+
+    memset(&data, 0x0, sizeof(data));
+    data.values[0] = Value;
+    ioctl(fd, GPIOHANDLE_SET_LINE_VALUES_IOCTL, &data);
+}
+
+static UBYTE Linux_Digital_Read(UWORD Pin)
+{
+    UBYTE Value = 0;
+
+    DEV_Linux_Edge_Read(Pin, &Value);
+    return Value;
+}
+
+/******************************************************************************
+function:       SPI through spidev
+parameter:
+Info:           spidev accepts SPI_CHUNK bytes per transfer by default
+******************************************************************************/
+static void Linux_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+    struct spi_ioc_transfer tr;
+    UDOUBLE Chunk;
+
+    while (Len > 0) {
+        Chunk = Len > SPI_CHUNK ? SPI_CHUNK : Len;
+
+        memset(&tr, 0x0, sizeof(tr));
+        tr.tx_buf = (unsigned long) pData;
+        tr.len = Chunk;
+        tr.speed_hz = DEV_SPI_SPEED;
+        tr.bits_per_word = 8;
+
+        if (ioctl(Spi_fd, SPI_IOC_MESSAGE(1), &tr) < 0) {
+            printf("spidev write failed\r\n");
+            return;
+        }
+
+        pData += Chunk;
+        Len -= Chunk;
+    }
+}
+
+static void Linux_SPI_WriteByte(UBYTE Value)
+{
+    Linux_SPI_Write_nByte(&Value, 1);
+}
+
+/******************************************************************************
+function:       delay x ms
+parameter:
+Info:
+******************************************************************************/
+static void Linux_Delay_ms(UDOUBLE xms)
+{
+    struct timespec ts;
+
+    ts.tv_sec = xms / 1000;
+    ts.tv_nsec = (long) (xms % 1000) * 1000000;
+    nanosleep(&ts, NULL);
+}
+
+const DEV_BACKEND DEV_Backend_Linux = {
+    "linux", 0,
+    Linux_ModuleInit, Linux_ModuleExit,
+    Linux_Digital_Write, Linux_Digital_Read,
+    Linux_SPI_WriteByte, Linux_SPI_Write_nByte,
+    Linux_Delay_ms,
+    DEV_Linux_Wait_Edge,
+    DEV_Monotonic_ms
+};
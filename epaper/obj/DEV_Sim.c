@@ -0,0 +1,401 @@
+/*****************************************************************************
+* | File        :   DEV_Sim.c
+* | Author      :   agent
+* | Function    :   Hardware backend with a simulated 7.5inch B panel
+* | Info        :
+*                Decodes the controller command stream sent over SPI into a
+*                framebuffer and models the BUSY pin. Time is simulated, a
+*                delay or wait for BUSY returns at once and only moves the
+*                simulated clock forward. Sending a byte costs the time it
+*                takes at DEV_SPI_SPEED.
+*
+*                Option (-b sim:file) : after every refresh the displayed
+*                frame is written to file as a PPM image.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "DEV_Config.h"
+#include "EPD_7in5b.h"
+# include <stdlib.h>
+# include <string.h>
+
+/**
+ * BUSY time of the panel operations
+**/
+#define SIM_REFRESH_MS      15000
+#define SIM_POWER_ON_MS     100
+#define SIM_POWER_OFF_MS    50
+
+/* simulated clock and BUSY release in ns */
+static uint64_t Sim_Clock = 0;
+static uint64_t Sim_Busy_Until = 0;
+static uint64_t Sim_Byte_ns = 8000000000ULL / DEV_SPI_SPEED;
+
+/* pins */
+static UBYTE Sim_DC = 0;
+static UBYTE Sim_CS = 1;
+static UBYTE Sim_RST = 1;
+
+/* controller state */
+static UBYTE Sim_Cmd = 0xff;
+static UBYTE Sim_Sleep = 0;
+static UDOUBLE Sim_Index = 0;
+static UBYTE Sim_Ram[EPD_FRAME_BYTES];          // written with DATA_START_TRANSMISSION_1
+static UBYTE Sim_Panel[EPD_FRAME_BYTES];        // shown on the panel
+
+/* partial window (PARTIAL_WINDOW), in pixels, end inclusive */
+static UBYTE Sim_Partial = 0;
+static UBYTE Sim_Window[9];
+static UWORD Sim_Win_Xstart, Sim_Win_Xend, Sim_Win_Ystart, Sim_Win_Yend;
+
+/* statistics */
+static UDOUBLE Sim_Commands = 0;
+static UDOUBLE Sim_Data_Bytes = 0;
+static UDOUBLE Sim_Refreshes = 0;
+static UDOUBLE Sim_Partial_Refreshes = 0;
+static UDOUBLE Sim_Inits = 0;
+
+static char Sim_Output[100] = "";
+
+/******************************************************************************
+function:       Make BUSY low for a time
+parameter:
+    xms :       busy time in ms
+******************************************************************************/
+static void Sim_Busy(UDOUBLE xms)
+{
+    Sim_Busy_Until = Sim_Clock + (uint64_t) xms * 1000000;
+}
+
+/******************************************************************************
+function:       Write the panel content as PPM image
+parameter:
+Info:           every 4 bit pixel is black (0x0), red (0x4) or white
+******************************************************************************/
+static void Sim_Write_Output(void)
+{
+    static const UBYTE rgb_black[3] = {0x00, 0x00, 0x00};
+    static const UBYTE rgb_white[3] = {0xff, 0xff, 0xff};
+    static const UBYTE rgb_red[3] = {0xff, 0x00, 0x00};
+    const UBYTE *rgb;
+    UBYTE Pixel;
+    UDOUBLE i;
+    FILE *fp;
+
+    if (Sim_Output[0] == 0x0) return;
+
+    if ((fp = fopen(Sim_Output, "wb")) == NULL) {
+        printf("sim: can not write %s\r\n", Sim_Output);
+        return;
+    }
+
+    fprintf(fp, "P6\n%d %d\n255\n", EPD_WIDTH, EPD_HEIGHT);
+
+    for (i = 0; i < EPD_FRAME_BYTES * 2; i++) {
+        Pixel = (i & 1) ? Sim_Panel[i / 2] & 0x0f : Sim_Panel[i / 2] >> 4;
+
+        if (Pixel == 0x00) rgb = rgb_black;
+        else if (Pixel == 0x04) rgb = rgb_red;
+        else rgb = rgb_white;
+
+        fwrite(rgb, 1, 3, fp);
+    }
+
+    fclose(fp);
+}
+
+/******************************************************************************
+function:       Offset in the frame of a byte written in the partial window
+parameter:
+    Index :     byte number since DATA_START_TRANSMISSION_1
+Info:           return EPD_FRAME_BYTES if outside the window
+******************************************************************************/
+static UDOUBLE Sim_Window_Offset(UDOUBLE Index)
+{
+    UDOUBLE Width = (Sim_Win_Xend - Sim_Win_Xstart + 1) / 2;       // bytes per line
+    UDOUBLE Y = Sim_Win_Ystart + Index / Width;
+
+    if (Y > Sim_Win_Yend) return EPD_FRAME_BYTES;
+
+    return Y * (EPD_WIDTH / 2) + Sim_Win_Xstart / 2 + Index % Width;
+}
+
+/******************************************************************************
+function:       Copy the controller memory to the panel
+parameter:
+Info:           in partial mode only the window is refreshed
+******************************************************************************/
+static void Sim_Refresh(void)
+{
+    UDOUBLE Offset, Width;
+    UWORD Y;
+
+    if (! Sim_Partial) {
+        memcpy(Sim_Panel, Sim_Ram, EPD_FRAME_BYTES);
+        return;
+    }
+
+    Width = (Sim_Win_Xend - Sim_Win_Xstart + 1) / 2;
+
+    for (Y = Sim_Win_Ystart; Y <= Sim_Win_Yend; Y++) {
+        Offset = Y * (EPD_WIDTH / 2) + Sim_Win_Xstart / 2;
+        memcpy(Sim_Panel + Offset, Sim_Ram + Offset, Width);
+    }
+
+    Sim_Partial_Refreshes++;
+}
+
+/******************************************************************************
+function:       Handle a command byte
+parameter:
+    Cmd :       command register
+******************************************************************************/
+static void Sim_Command(UBYTE Cmd)
+{
+    Sim_Commands++;
+    Sim_Cmd = Cmd;
+    Sim_Index = 0;
+
+    if (Sim_Sleep) {
+        printf("sim: command 0x%02x while in deep sleep\r\n", Cmd);
+        return;
+    }
+
+    switch (Cmd) {
+        case POWER_ON:
+            Sim_Busy(SIM_POWER_ON_MS);
+            break;
+
+        case POWER_OFF:
+            Sim_Busy(SIM_POWER_OFF_MS);
+            break;
+
+        case DISPLAY_REFRESH:
+            if (Sim_Clock < Sim_Busy_Until)
+                printf("sim: refresh while busy\r\n");
+
+            Sim_Refresh();
+            Sim_Refreshes++;
+            Sim_Busy(SIM_REFRESH_MS);
+            Sim_Write_Output();
+            break;
+
+        case PARTIAL_IN:
+            Sim_Partial = 1;
+            Sim_Win_Xstart = 0;
+            Sim_Win_Xend = EPD_WIDTH - 1;
+            Sim_Win_Ystart = 0;
+            Sim_Win_Yend = EPD_HEIGHT - 1;
+            break;
+
+        case PARTIAL_OUT:
+            Sim_Partial = 0;
+            break;
+
+        case GET_STATUS:
+        default:
+            break;
+    }
+}
+
+/******************************************************************************
+function:       Handle a data byte
+parameter:
+    Data :      byte for the last command
+******************************************************************************/
+static void Sim_Data(UBYTE Data)
+{
+    UDOUBLE Offset;
+
+    Sim_Data_Bytes++;
+
+    if (Sim_Sleep) return;
+
+    switch (Sim_Cmd) {
+        case DATA_START_TRANSMISSION_1:
+            Offset = Sim_Partial ? Sim_Window_Offset(Sim_Index) : Sim_Index;
+            if (Offset < EPD_FRAME_BYTES) Sim_Ram[Offset] = Data;
+            break;
+
+        case PARTIAL_WINDOW:
+            if (Sim_Index >= sizeof(Sim_Window)) break;
+
+            Sim_Window[Sim_Index] = Data;
+
+            if (Sim_Index == sizeof(Sim_Window) - 1) {
+                Sim_Win_Xstart = ((Sim_Window[0] & 0x03) << 8 | Sim_Window[1]) & 0x3f8;
+                Sim_Win_Xend = ((Sim_Window[2] & 0x03) << 8 | Sim_Window[3]) | 0x007;
+                Sim_Win_Ystart = (Sim_Window[4] & 0x01) << 8 | Sim_Window[5];
+                Sim_Win_Yend = (Sim_Window[6] & 0x01) << 8 | Sim_Window[7];
+
+                if (Sim_Win_Xend >= EPD_WIDTH) Sim_Win_Xend = EPD_WIDTH - 1;
+                if (Sim_Win_Yend >= EPD_HEIGHT) Sim_Win_Yend = EPD_HEIGHT - 1;
+
+                if (Sim_Win_Xstart > Sim_Win_Xend || Sim_Win_Ystart > Sim_Win_Yend) {
+                    printf("sim: invalid partial window\r\n");
+                    Sim_Win_Xstart = Sim_Win_Ystart = 0;
+                    Sim_Win_Xend = EPD_WIDTH - 1;
+                    Sim_Win_Yend = EPD_HEIGHT - 1;
+                }
+            }
+            break;
+
+        case DEEP_SLEEP:
+            if (Data == 0xA5) Sim_Sleep = 1;
+            break;
+
+        default:
+            break;
+    }
+
+    Sim_Index++;
+}
+
+/******************************************************************************
+function:       Module Initialize, reset the simulated panel
+parameter:
+    Option :    optional PPM file to write after every refresh
+******************************************************************************/
+static UBYTE Sim_ModuleInit(const char *Option)
+{
+    if (Option) {
+        strncpy(Sim_Output, Option, sizeof(Sim_Output) - 1);
+        Sim_Output[sizeof(Sim_Output) - 1] = 0x0;
+    }
+
+    memset(Sim_Ram, 0x33, EPD_FRAME_BYTES);
+    memset(Sim_Panel, 0x33, EPD_FRAME_BYTES);
+
+    printf("simulated panel init success !!! \r\n");
+    return 0;
+}
+
+/******************************************************************************
+function:       Module exits, show what the simulated panel has seen
+parameter:
+******************************************************************************/
+static void Sim_ModuleExit(void)
+{
+    printf("sim: %u ms, %u inits, %u commands, %u data bytes, %u refreshes (%u partial)\r\n",
+        (UDOUBLE) (Sim_Clock / 1000000), Sim_Inits, Sim_Commands, Sim_Data_Bytes,
+        Sim_Refreshes, Sim_Partial_Refreshes);
+}
+
+/******************************************************************************
+function:       GPIO
+parameter:
+Info:           a RST pulse (low to high) resets the controller
+******************************************************************************/
+static void Sim_Digital_Write(UWORD Pin, UBYTE Value)
+{
+    switch (Pin) {
+        case EPD_DC_PIN:
+            Sim_DC = Value;
+            break;
+
+        case EPD_CS_PIN:
+            Sim_CS = Value;
+            break;
+
+        case EPD_RST_PIN:
+            if (! Sim_RST && Value) {
+                Sim_Sleep = 0;
+                Sim_Partial = 0;
+                Sim_Cmd = 0xff;
+                Sim_Busy_Until = Sim_Clock;
+                Sim_Inits++;
+            }
+            Sim_RST = Value;
+            break;
+    }
+}
+
+static UBYTE Sim_Digital_Read(UWORD Pin)
+{
+    if (Pin != EPD_BUSY_PIN) return 0;
+
+    Sim_Clock += 1000;                      // a read takes time as well
+
+    return Sim_Clock >= Sim_Busy_Until;     // 0 = busy
+}
+
+/******************************************************************************
+function:       SPI
+parameter:
+Info:           bytes are only seen with CS low
+******************************************************************************/
+static void Sim_SPI_Write_nByte(UBYTE *pData, UDOUBLE Len)
+{
+    Sim_Clock += Sim_Byte_ns * Len;
+
+    if (Sim_CS) return;
+
+    while (Len-- > 0) {
+        if (Sim_DC) Sim_Data(*pData++);
+        else Sim_Command(*pData++);
+    }
+}
+
+static void Sim_SPI_WriteByte(UBYTE Value)
+{
+    Sim_SPI_Write_nByte(&Value, 1);
+}
+
+/******************************************************************************
+function:       delay, wait and time on the simulated clock
+parameter:
+******************************************************************************/
+static void Sim_Delay_ms(UDOUBLE xms)
+{
+    Sim_Clock += (uint64_t) xms * 1000000;
+}
+
+static UBYTE Sim_Wait_Edge(UWORD Pin, UDOUBLE Timeout_ms)
+{
+    uint64_t Timeout = (uint64_t) Timeout_ms * 1000000;
+
+    if (Sim_Clock >= Sim_Busy_Until) return DEV_WAIT_OK;
+
+    if (Sim_Busy_Until - Sim_Clock > Timeout) {
+        Sim_Clock += Timeout;
+        return DEV_WAIT_TIMEOUT;
+    }
+
+    Sim_Clock = Sim_Busy_Until;
+    return DEV_WAIT_OK;
+}
+
+static UDOUBLE Sim_Time_ms(void)
+{
+    return (UDOUBLE) (Sim_Clock / 1000000);
+}
+
+const DEV_BACKEND DEV_Backend_Sim = {
+    "sim", 0,
+    Sim_ModuleInit, Sim_ModuleExit,
+    Sim_Digital_Write, Sim_Digital_Read,
+    Sim_SPI_WriteByte, Sim_SPI_Write_nByte,
+    Sim_Delay_ms,
+    Sim_Wait_Edge,
+    Sim_Time_ms
+};
@@ -17,6 +17,19 @@
 *   EPD_BUSY -> EPD_BUSY_PIN
 * 
 * 4. EPD_Set_Border() has been added by paulvh
+* 5. EPD_Display() / EPD_Clear() pack the frame in RAM and sent it as a
+*    single SPI block transfer instead of toggling CS for every byte
+* 6. EPD_PackPlanes() converts the black and red planes with a lookup table
+* 7. EPD_WaitUntilIdle() can sleep on the BUSY edge or poll with an interval
+*    instead of spinning, see EPD_SetWaitMode()
+* 8. EPD_DisplayPartial() sends and refreshes only a window of the panel
+* 9. EPD_FrameHash() to detect a frame that is already displayed
+* 10. EPD_DisplayPacked() sends a frame that is already in the controller
+*    format (frame file, see EPD_Frame.c)
+* 11. The EPD_PackPlanes() table is created by the first EPD_Init(), before
+*    threads can pack frames (epaper -A)
+* 12. EPD_Clear(), EPD_Display*() and EPD_Sleep() return 1 on a busy timeout
+*    and stop sending commands to the controller
 
 #
 # Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -40,6 +53,19 @@
 ******************************************************************************/
 #include "EPD_7in5b.h"
 //#include "Debug.h"
+#include <string.h> //memset()
+
+// packed frame as sent to the controller (4 bit per pixel)
+static UBYTE EPD_Frame[EPD_FRAME_BYTES];
+
+// 4 pixels (black nibble << 4 | red nibble) to 2 controller bytes
+static UBYTE EPD_PackTable[256][2];
+static UBYTE EPD_PackTable_Init = 0;
+
+// how to wait for BUSY release
+static EPD_WAIT_MODE EPD_Wait_Mode = EPD_WAIT_EDGE;
+static UDOUBLE EPD_Wait_Poll = EPD_WAIT_POLL_DFT;
+static UDOUBLE EPD_Wait_Timeout = EPD_WAIT_TIMEOUT_DFT;
 
 /******************************************************************************
 function :  Software reset
@@ -82,36 +108,144 @@ static void EPD_SendData(UBYTE Data)
     DEV_Digital_Write(EPD_CS_PIN, 1);
 }
 
+/******************************************************************************
+function :  send a block of data
+parameter:
+    Data : Write data
+    Len  : number of bytes
+Info:
+    DC and CS are set once for the complete block instead of for every byte
+******************************************************************************/
+static void EPD_SendDataBlock(UBYTE *Data, UDOUBLE Len)
+{
+    DEV_Digital_Write(EPD_DC_PIN, 1);       // 4 wire SPI Data = 1
+    DEV_Digital_Write(EPD_CS_PIN, 0);
+    DEV_SPI_Write_nByte(Data, Len);
+    DEV_Digital_Write(EPD_CS_PIN, 1);
+}
+
+/******************************************************************************
+function :  Set the way to wait for the busy_pin
+parameter:
+    Mode       : EPD_WAIT_SPIN, EPD_WAIT_POLL or EPD_WAIT_EDGE
+    Poll_ms    : interval to check the busy_pin (0 = keep current)
+    Timeout_ms : give up after this time (0 = wait forever)
+Info:
+    EPD_WAIT_SPIN  keeps sending GET_STATUS and reading the busy_pin
+    EPD_WAIT_POLL  checks the busy_pin every Poll_ms and sleeps in between
+    EPD_WAIT_EDGE  sleeps until the busy_pin goes high. The pin is checked
+                   every Poll_ms as well, in case an edge is missed. Falls
+                   back to EPD_WAIT_POLL if edge events are not available.
+******************************************************************************/
+void EPD_SetWaitMode(EPD_WAIT_MODE Mode, UDOUBLE Poll_ms, UDOUBLE Timeout_ms)
+{
+    EPD_Wait_Mode = Mode;
+    if (Poll_ms > 0) EPD_Wait_Poll = Poll_ms;
+    EPD_Wait_Timeout = Timeout_ms;
+}
+
 /******************************************************************************
 function :  Wait until the busy_pin goes LOW
 parameter:
+Info:
+    return 0 = idle, 1 = timeout
 ******************************************************************************/
-void EPD_WaitUntilIdle(void)
+UBYTE EPD_WaitUntilIdle(void)
 {
     UBYTE busy;
+    UDOUBLE start;
+
     Debug("e-Paper busy\r\n");
-    do {
-        EPD_SendCommand(0x71);                  // GET_STATUS (returned BYTE is NOT used !!)
-        busy = DEV_Digital_Read(EPD_BUSY_PIN);
-        busy =!(busy & 0x01);
-    } while(busy);
+
+    if (EPD_Wait_Mode == EPD_WAIT_SPIN) {
+        do {
+            EPD_SendCommand(GET_STATUS);        // returned BYTE is NOT used !!
+            busy = DEV_Digital_Read(EPD_BUSY_PIN);
+            busy =!(busy & 0x01);
+        } while(busy);
+
+        Debug("e-Paper busy release\r\n");
+        return 0;
+    }
+
+    start = DEV_Time_ms();
+
+    while (1) {
+
+        if (EPD_Wait_Mode == EPD_WAIT_POLL)
+            EPD_SendCommand(GET_STATUS);        // returned BYTE is NOT used !!
+
+        if (DEV_Digital_Read(EPD_BUSY_PIN) & 0x01) break;
+
+        if (EPD_Wait_Timeout > 0 && DEV_Time_ms() - start >= EPD_Wait_Timeout) {
+            printf("e-Paper busy timeout after %u ms\r\n", EPD_Wait_Timeout);
+            return 1;
+        }
+
+        if (EPD_Wait_Mode == EPD_WAIT_EDGE) {
+            if (DEV_Wait_Edge(EPD_BUSY_PIN, EPD_Wait_Poll) != DEV_WAIT_NOEDGE)
+                continue;
+
+            Debug("no edge detection on busy_pin, polling instead\r\n");
+            EPD_Wait_Mode = EPD_WAIT_POLL;
+        }
+
+        DEV_Delay_ms(EPD_Wait_Poll);
+    }
+
     Debug("e-Paper busy release\r\n");
+    return 0;
 }
 
 /******************************************************************************
 function :  Turn On Display
 parameter:
+Info:
+    return 0 = refreshed, 1 = timeout
 ******************************************************************************/
-static void EPD_TurnOnDisplay(void)
+static UBYTE EPD_TurnOnDisplay(void)
 {
     Debug("Turn display on\n");
     EPD_SendCommand(POWER_ON);          //POWER ON
-    EPD_WaitUntilIdle();
+    if (EPD_WaitUntilIdle()) return 1;
     Debug("refresh\n");
     EPD_SendCommand(DISPLAY_REFRESH);   //display refresh
     DEV_Delay_ms(100);
-    EPD_WaitUntilIdle();
+    if (EPD_WaitUntilIdle()) return 1;
     Debug("Refresh done\n");
+    return 0;
+}
+
+/******************************************************************************
+function :  Create the lookup table for EPD_PackPlanes()
+parameter:
+Info:
+    A pixel is red0 (0x4) if the red bit is 0, else black (0x0) if the black
+    bit is 0, else white (0x3). Every entry holds 4 pixels as 2 bytes.
+******************************************************************************/
+static void EPD_PackTableInit(void)
+{
+    UWORD Index;
+    UBYTE k, Black, Red, Data[4];
+
+    for (Index = 0; Index < 256; Index++) {
+        Black = Index >> 4;
+        Red = Index & 0x0F;
+
+        for (k = 0; k < 4; k++) {
+            if ((Red & (0x08 >> k)) == 0x00)
+                Data[k] = 0x04;                 //red0
+            else if ((Black & (0x08 >> k)) == 0x00)
+                Data[k] = 0x00;                 //black
+            else
+                Data[k] = 0x03;                 //white
+        }
+
+        EPD_PackTable[Index][0] = (Data[0] << 4) | Data[1];
+        EPD_PackTable[Index][1] = (Data[2] << 4) | Data[3];
+    }
+
+    EPD_PackTable_Init = 1;
 }
 
 /******************************************************************************
@@ -120,6 +254,9 @@ parameter:
 ******************************************************************************/
 UBYTE EPD_Init(void)
 {
+    // only written here, the first time is before any thread starts
+    if (! EPD_PackTable_Init) EPD_PackTableInit();
+
     EPD_Reset();                    // reset pin high/low/high
 
     EPD_SendCommand(POWER_SETTING); // 0x1
@@ -165,23 +302,17 @@ UBYTE EPD_Init(void)
 /******************************************************************************
 function :  Clear screen
 parameter:
+Info:
+    return 0 = cleared, 1 = timeout
 ******************************************************************************/
-void EPD_Clear(void)
+UBYTE EPD_Clear(void)
 {
-    UWORD Width, Height;
-    Width = (EPD_WIDTH % 8 == 0)? (EPD_WIDTH / 8): (EPD_WIDTH / 8 + 1);
-    Height = EPD_HEIGHT;
+    memset(EPD_Frame, 0x33, EPD_FRAME_BYTES);   // dummy(0) white(3) dummy(0) white(3)
 
     EPD_SendCommand(DATA_START_TRANSMISSION_1);
-    for (UWORD j = 0; j < Height; j++) {
-        for (UWORD i = 0; i < Width; i++) {
-            for(UBYTE k = 0; k < 4; k++) {
-                EPD_SendData(0x33);             // dummy(0) white(3) dummy(0) white(3)
-            }
-        }
-    }
+    EPD_SendDataBlock(EPD_Frame, EPD_FRAME_BYTES);
 
-    EPD_TurnOnDisplay();
+    return EPD_TurnOnDisplay();
 }
 
 /******************************************************************************
@@ -218,61 +349,165 @@ int EPD_Set_Border(char color)
     return 0;
 }
 
+/******************************************************************************
+function :  Convert the black and red image planes to the controller format
+parameter:
+    Imageblack : black plane (1 bit per pixel, 0 = black)
+    Imagered   : red plane (1 bit per pixel, 0 = red)
+    Frame      : receives Len * 4 bytes (4 bit per pixel)
+    Len        : number of bytes in each plane
+Info:
+    Does not touch the hardware. The lookup table is created by EPD_Init().
+******************************************************************************/
+void EPD_PackPlanes(const UBYTE *Imageblack, const UBYTE *Imagered, UBYTE *Frame, UDOUBLE Len)
+{
+    UBYTE Data_Black, Data_Red;
+    const UBYTE *Hi, *Lo;
+    UDOUBLE i;
+
+    for (i = 0; i < Len; i++) {
+        Data_Black = Imageblack[i];
+        Data_Red = Imagered[i];
+
+        Hi = EPD_PackTable[(Data_Black & 0xF0) | (Data_Red >> 4)];
+        Lo = EPD_PackTable[((Data_Black & 0x0F) << 4) | (Data_Red & 0x0F)];
+
+        Frame[0] = Hi[0];
+        Frame[1] = Hi[1];
+        Frame[2] = Lo[0];
+        Frame[3] = Lo[1];
+        Frame += 4;
+    }
+}
+
+/******************************************************************************
+function :  Hash of the black and red image planes
+parameter:
+    Imageblack : black plane (EPD_PLANE_BYTES)
+    Imagered   : red plane (EPD_PLANE_BYTES)
+Info:
+    64 bit FNV-1a. Used to find out whether a frame is the same as the
+    one shown on the panel. Does not touch the hardware.
+******************************************************************************/
+uint64_t EPD_FrameHash(const UBYTE *Imageblack, const UBYTE *Imagered)
+{
+    uint64_t Hash = 0xcbf29ce484222325ULL;
+    UDOUBLE i;
+
+    for (i = 0; i < EPD_PLANE_BYTES; i++) {
+        Hash ^= Imageblack[i];
+        Hash *= 0x100000001b3ULL;
+    }
+
+    for (i = 0; i < EPD_PLANE_BYTES; i++) {
+        Hash ^= Imagered[i];
+        Hash *= 0x100000001b3ULL;
+    }
+
+    return Hash;
+}
+
 /******************************************************************************
 function :  Sends the image buffer in RAM to e-Paper and displays
 parameter:
+Info:
+    return 0 = displayed, 1 = timeout
 ******************************************************************************/
-void EPD_Display(UBYTE *Imageblack, UBYTE *Imagered)
+UBYTE EPD_Display(UBYTE *Imageblack, UBYTE *Imagered)
 {
-    UBYTE Data_Black, Data_Red, Data;
-    UDOUBLE i, j, Width, Height;
-    Width = (EPD_WIDTH % 8 == 0)? (EPD_WIDTH / 8 ): (EPD_WIDTH / 8 + 1);
-    Height = EPD_HEIGHT;
+    EPD_PackPlanes(Imageblack, Imagered, EPD_Frame, EPD_FRAME_BYTES / 4);
 
     EPD_SendCommand(DATA_START_TRANSMISSION_1);
-    for (j = 0; j < Height; j++) {
-        for (i = 0; i < Width; i++) {
-            Data_Black = Imageblack[i + j * Width];
-            Data_Red = Imagered[i + j * Width];
-            for(UBYTE k = 0; k < 8; k++) {
-                if ((Data_Red & 0x80) == 0x00) {
-                    Data = 0x04;               //red0
-                } else if ((Data_Black & 0x80) == 0x00) {
-                    Data = 0x00;               //black
-                } else {
-                    Data = 0x03;               //white
-                }
-                Data = (Data << 4) & 0xFF;
-                Data_Black = (Data_Black << 1) & 0xFF;
-                Data_Red = (Data_Red << 1) & 0xFF;
-                k += 1;
-
-                if((Data_Red & 0x80) == 0x00) {
-                    Data |= 0x04;              //red
-                } else if ((Data_Black & 0x80) == 0x00) {
-                    Data |= 0x00;              //black
-                } else {
-                    Data |= 0x03;              //white
-                }
-                Data_Black = (Data_Black << 1) & 0xFF;
-                Data_Red = (Data_Red << 1) & 0xFF;
-                EPD_SendData(Data);
-            }
-        }
+    EPD_SendDataBlock(EPD_Frame, EPD_FRAME_BYTES);
+
+    return EPD_TurnOnDisplay();
+}
+
+/******************************************************************************
+function :  Sends a frame in the controller format to e-Paper and displays
+parameter:
+    Frame : EPD_FRAME_BYTES, as created by EPD_PackPlanes()
+Info:
+    return 0 = displayed, 1 = timeout
+******************************************************************************/
+UBYTE EPD_DisplayPacked(const UBYTE *Frame)
+{
+    EPD_SendCommand(DATA_START_TRANSMISSION_1);
+    EPD_SendDataBlock((UBYTE *) Frame, EPD_FRAME_BYTES);
+
+    return EPD_TurnOnDisplay();
+}
+
+/******************************************************************************
+function :  Sends a window of the image buffer in RAM to e-Paper and displays
+parameter:
+    Imageblack : black plane (1 bit per pixel, 0 = black)
+    Imagered   : red plane (1 bit per pixel, 0 = red)
+    Xstart     : x starting point
+    Ystart     : Y starting point
+    Xend       : x end point (inclusive)
+    Yend       : y end point (inclusive)
+Info:
+    The controller takes the horizontal window in steps of 8 pixels, Xstart
+    and Xend are widened to that. Only the window is transmitted and only
+    the window is refreshed, the rest of the panel keeps what it shows.
+    return 0 = displayed, 1 = timeout
+******************************************************************************/
+UBYTE EPD_DisplayPartial(UBYTE *Imageblack, UBYTE *Imagered, UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend)
+{
+    UWORD Y, Width_Byte;
+    UDOUBLE Addr, Len = 0;
+
+    if (Xend >= EPD_WIDTH) Xend = EPD_WIDTH - 1;
+    if (Yend >= EPD_HEIGHT) Yend = EPD_HEIGHT - 1;
+    if (Xstart > Xend || Ystart > Yend) return 0;
+
+    Xstart &= 0xfff8;
+    Xend |= 0x0007;
+    Width_Byte = (Xend - Xstart + 1) / 8;
+
+    Debug("partial window x %d - %d, y %d - %d\n", Xstart, Xend, Ystart, Yend);
+
+    for (Y = Ystart; Y <= Yend; Y++) {
+        Addr = Y * (EPD_WIDTH / 8) + Xstart / 8;
+        EPD_PackPlanes(Imageblack + Addr, Imagered + Addr, EPD_Frame + Len, Width_Byte);
+        Len += Width_Byte * 4;
     }
 
-    EPD_TurnOnDisplay(); 
+    EPD_SendCommand(PARTIAL_IN);
+
+    EPD_SendCommand(PARTIAL_WINDOW);
+    EPD_SendData(Xstart >> 8);
+    EPD_SendData(Xstart & 0xf8);        // HRST[2:0] are ignored
+    EPD_SendData(Xend >> 8);
+    EPD_SendData(Xend & 0xff);          // HRED[2:0] must be 111
+    EPD_SendData(Ystart >> 8);
+    EPD_SendData(Ystart & 0xff);
+    EPD_SendData(Yend >> 8);
+    EPD_SendData(Yend & 0xff);
+    EPD_SendData(0x01);                 // gate scan inside and outside window
+
+    EPD_SendCommand(DATA_START_TRANSMISSION_1);
+    EPD_SendDataBlock(EPD_Frame, Len);
+
+    if (EPD_TurnOnDisplay()) return 1;
+
+    EPD_SendCommand(PARTIAL_OUT);
+    return 0;
 }
 
 /******************************************************************************
 function :  Enter sleep mode
 parameter:
+Info:
+    return 0 = sleeping, 1 = timeout
 ******************************************************************************/
-void EPD_Sleep(void)
+UBYTE EPD_Sleep(void)
 {
     Debug("Set to Sleep\n");
     EPD_SendCommand(POWER_OFF);
-    EPD_WaitUntilIdle();
+    if (EPD_WaitUntilIdle()) return 1;
     EPD_SendCommand(DEEP_SLEEP);
     EPD_SendData(0XA5);
+    return 0;
 }
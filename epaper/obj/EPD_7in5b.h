@@ -39,6 +39,12 @@
 #define EPD_WIDTH       640
 #define EPD_HEIGHT      384
 
+// size of the packed frame (4 bit per pixel) sent to the controller
+#define EPD_FRAME_BYTES ((EPD_WIDTH / 2) * EPD_HEIGHT)
+
+// size of the black or red plane (1 bit per pixel)
+#define EPD_PLANE_BYTES ((EPD_WIDTH / 8) * EPD_HEIGHT)
+
 // EPD7IN5B commands
 #define PANEL_SETTING                               0x00
 #define POWER_SETTING                               0x01
@@ -77,11 +83,32 @@
 #define AUTO_MEASUREMENT_VCOM                       0x80
 #define READ_VCOM_VALUE                             0x81
 #define VCM_DC_SETTING                              0x82
+#define PARTIAL_WINDOW                              0x90
+#define PARTIAL_IN                                  0x91
+#define PARTIAL_OUT                                 0x92
+
+/**
+ * How to wait for the busy_pin
+**/
+typedef enum {
+    EPD_WAIT_SPIN = 0,      // keep sending GET_STATUS (original)
+    EPD_WAIT_POLL,          // check every poll interval and sleep
+    EPD_WAIT_EDGE,          // sleep on the rising edge of the busy_pin
+} EPD_WAIT_MODE;
+
+#define EPD_WAIT_POLL_DFT       50      // ms
+#define EPD_WAIT_TIMEOUT_DFT    60000   // ms (a refresh takes about 15s)
 
 UBYTE EPD_Init(void);
-void EPD_Clear(void);
-void EPD_Display(UBYTE *Imageblack, UBYTE *Imagered);
-void EPD_Sleep(void);
+UBYTE EPD_Clear(void);
+UBYTE EPD_Display(UBYTE *Imageblack, UBYTE *Imagered);
+UBYTE EPD_DisplayPacked(const UBYTE *Frame);
+UBYTE EPD_DisplayPartial(UBYTE *Imageblack, UBYTE *Imagered, UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend);
+void EPD_PackPlanes(const UBYTE *Imageblack, const UBYTE *Imagered, UBYTE *Frame, UDOUBLE Len);
+uint64_t EPD_FrameHash(const UBYTE *Imageblack, const UBYTE *Imagered);
+UBYTE EPD_Sleep(void);
 int EPD_Set_Border(char color);
+void EPD_SetWaitMode(EPD_WAIT_MODE Mode, UDOUBLE Poll_ms, UDOUBLE Timeout_ms);
+UBYTE EPD_WaitUntilIdle(void);
 
 #endif
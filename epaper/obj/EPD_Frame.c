@@ -0,0 +1,262 @@
+/*****************************************************************************
+* | File        :   EPD_Frame.c
+* | Author      :   agent
+* | Function    :   Frame files and recently displayed frames
+* | Info        :
+*                A frame file holds the black and the red image and the
+*                same frame in the controller format. It is mapped in
+*                memory, so the frame can be sent to the panel without
+*                drawing or packing it again (EPD_DisplayPacked()).
+*
+*                The packed frames of the last EPD_PACKED_CACHE displayed
+*                images are kept (least recently used is replaced), showing
+*                one of those again needs no packing.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#define _DEFAULT_SOURCE          // le16toh() and friends
+#include "EPD_Frame.h"
+#include "EPD_7in5b.h"
+# include <stdlib.h>
+# include <string.h>
+# include <endian.h>     // le16toh()
+# include <fcntl.h>      // open()
+# include <unistd.h>     // close()
+# include <sys/mman.h>   // mmap()
+# include <sys/stat.h>   // fstat()
+
+/* recently displayed frames, Packed NULL = empty */
+typedef struct {
+    uint64_t Hash;
+    UDOUBLE Used;               // EPD_Packed_Clock when last used
+    UBYTE *Black;               // EPD_PLANE_BYTES
+    UBYTE *Red;                 // EPD_PLANE_BYTES
+    UBYTE *Packed;              // EPD_FRAME_BYTES
+} EPD_PACKED;
+
+static EPD_PACKED EPD_Packed[EPD_PACKED_CACHE];
+static UDOUBLE EPD_Packed_Clock = 0;
+static UDOUBLE EPD_Packed_Hits = 0, EPD_Packed_Misses = 0;
+
+/******************************************************************************
+function:   Write the images as frame file
+parameter:
+    File       : frame file to create
+    Imageblack : black plane (EPD_PLANE_BYTES)
+    Imagered   : red plane (EPD_PLANE_BYTES)
+Info:
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE EPD_FrameSave(const char *File, const UBYTE *Imageblack, const UBYTE *Imagered)
+{
+    EPD_FRAME_HEADER Header;
+    UBYTE *Packed;
+    FILE *fp;
+
+    if ((Packed = (UBYTE *) malloc(EPD_FRAME_BYTES)) == NULL) {
+        printf("no memory for frame file %s\r\n", File);
+        return 1;
+    }
+
+    EPD_PackPlanes(Imageblack, Imagered, Packed, EPD_PLANE_BYTES);
+
+    memset(&Header, 0x0, sizeof(Header));
+    memcpy(Header.Magic, EPD_FRAME_MAGIC, sizeof(Header.Magic));
+    Header.Width = htole16(EPD_WIDTH);
+    Header.Height = htole16(EPD_HEIGHT);
+    Header.Plane_Bytes = htole32(EPD_PLANE_BYTES);
+    Header.Frame_Bytes = htole32(EPD_FRAME_BYTES);
+    Header.Hash = htole64(EPD_FrameHash(Imageblack, Imagered));
+    Header.Black = htole32(sizeof(Header));
+    Header.Red = htole32(sizeof(Header) + EPD_PLANE_BYTES);
+    Header.Packed = htole32(sizeof(Header) + 2 * EPD_PLANE_BYTES);
+
+    if ((fp = fopen(File, "wb")) == NULL) {
+        printf("can not create frame file %s\r\n", File);
+        free(Packed);
+        return 1;
+    }
+
+    fwrite(&Header, sizeof(Header), 1, fp);
+    fwrite(Imageblack, EPD_PLANE_BYTES, 1, fp);
+    fwrite(Imagered, EPD_PLANE_BYTES, 1, fp);
+    fwrite(Packed, EPD_FRAME_BYTES, 1, fp);
+    free(Packed);
+
+    if (ferror(fp) | fclose(fp)) {
+        printf("error writing frame file %s\r\n", File);
+        return 1;
+    }
+
+    Debug("frame written to %s\r\n", File);
+    return 0;
+}
+
+/******************************************************************************
+function:   Open a frame file
+parameter:
+    File    :   frame file
+    Frame   :   filled with pointers in the mapped file
+Info:
+    The file stays mapped until EPD_FrameClose()
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE EPD_FrameOpen(const char *File, EPD_FRAME *Frame)
+{
+    EPD_FRAME_HEADER Header;
+    struct stat st;
+    const UBYTE *Map;
+    int fd;
+
+    Frame->Map = NULL;
+
+    if ((fd = open(File, O_RDONLY)) < 0) {
+        printf("can not open frame file %s\r\n", File);
+        return 1;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(EPD_FRAME_HEADER)) {
+        printf("frame file %s is too short\r\n", File);
+        close(fd);
+        return 1;
+    }
+
+    Map = (const UBYTE *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (Map == MAP_FAILED) {
+        printf("can not map frame file %s\r\n", File);
+        return 1;
+    }
+
+    memcpy(&Header, Map, sizeof(Header));
+    Header.Black = le32toh(Header.Black);
+    Header.Red = le32toh(Header.Red);
+    Header.Packed = le32toh(Header.Packed);
+
+    if (memcmp(Header.Magic, EPD_FRAME_MAGIC, sizeof(Header.Magic)) != 0 ||
+        le16toh(Header.Width) != EPD_WIDTH || le16toh(Header.Height) != EPD_HEIGHT ||
+        le32toh(Header.Plane_Bytes) != EPD_PLANE_BYTES || le32toh(Header.Frame_Bytes) != EPD_FRAME_BYTES ||
+        (uint64_t) Header.Black + EPD_PLANE_BYTES > (uint64_t) st.st_size ||
+        (uint64_t) Header.Red + EPD_PLANE_BYTES > (uint64_t) st.st_size ||
+        (uint64_t) Header.Packed + EPD_FRAME_BYTES > (uint64_t) st.st_size) {
+        printf("frame file %s is not a frame for this panel\r\n", File);
+        munmap((void *) Map, st.st_size);
+        return 1;
+    }
+
+    Frame->Black = Map + Header.Black;
+    Frame->Red = Map + Header.Red;
+    Frame->Packed = Map + Header.Packed;
+    Frame->Hash = le64toh(Header.Hash);
+    Frame->Map = (void *) Map;
+    Frame->Size = st.st_size;
+
+    Debug("frame file %s opened\r\n", File);
+    return 0;
+}
+
+/******************************************************************************
+function:   Close a frame file
+parameter:
+    Frame   :   opened frame file (nothing happens if not open)
+******************************************************************************/
+void EPD_FrameClose(EPD_FRAME *Frame)
+{
+    if (Frame->Map == NULL) return;
+
+    munmap(Frame->Map, Frame->Size);
+    Frame->Map = NULL;
+}
+
+/******************************************************************************
+function:   Packed frame of the images
+parameter:
+    Hash       : EPD_FrameHash() of the images
+    Imageblack : black plane (EPD_PLANE_BYTES)
+    Imagered   : red plane (EPD_PLANE_BYTES)
+Info:
+    If the images were packed recently that frame is returned, else they
+    are packed in place of the least recently used frame. The images are
+    compared as well, a hash alone could match other images.
+    return EPD_FRAME_BYTES packed frame, NULL = no memory
+******************************************************************************/
+const UBYTE *EPD_PackedGet(uint64_t Hash, const UBYTE *Imageblack, const UBYTE *Imagered)
+{
+    EPD_PACKED *Entry, *Oldest = &EPD_Packed[0];
+    UBYTE i;
+
+    EPD_Packed_Clock++;
+
+    for (i = 0; i < EPD_PACKED_CACHE; i++) {
+        Entry = &EPD_Packed[i];
+
+        if (Entry->Packed && Entry->Hash == Hash &&
+            memcmp(Entry->Black, Imageblack, EPD_PLANE_BYTES) == 0 &&
+            memcmp(Entry->Red, Imagered, EPD_PLANE_BYTES) == 0) {
+            Entry->Used = EPD_Packed_Clock;
+            EPD_Packed_Hits++;
+            return Entry->Packed;
+        }
+
+        if (Entry->Packed == NULL || (Oldest->Packed && Entry->Used < Oldest->Used))
+            Oldest = Entry;
+    }
+
+    EPD_Packed_Misses++;
+    Entry = Oldest;
+
+    if (Entry->Packed == NULL) {
+        Entry->Black = (UBYTE *) malloc(EPD_PLANE_BYTES);
+        Entry->Red = (UBYTE *) malloc(EPD_PLANE_BYTES);
+        Entry->Packed = (UBYTE *) malloc(EPD_FRAME_BYTES);
+
+        if (Entry->Black == NULL || Entry->Red == NULL || Entry->Packed == NULL) {
+            free(Entry->Black);
+            free(Entry->Red);
+            free(Entry->Packed);
+            Entry->Packed = NULL;
+            return NULL;
+        }
+    }
+
+    memcpy(Entry->Black, Imageblack, EPD_PLANE_BYTES);
+    memcpy(Entry->Red, Imagered, EPD_PLANE_BYTES);
+    EPD_PackPlanes(Imageblack, Imagered, Entry->Packed, EPD_PLANE_BYTES);
+    Entry->Hash = Hash;
+    Entry->Used = EPD_Packed_Clock;
+
+    return Entry->Packed;
+}
+
+/******************************************************************************
+function:   Packed frame statistics
+parameter:
+    Hits    :   number of frames that did not need packing
+    Misses  :   number of frames packed
+******************************************************************************/
+void EPD_PackedStats(UDOUBLE *Hits, UDOUBLE *Misses)
+{
+    *Hits = EPD_Packed_Hits;
+    *Misses = EPD_Packed_Misses;
+}
@@ -0,0 +1,88 @@
+/*****************************************************************************
+* | File        :   EPD_Frame.h
+* | Author      :   agent
+* | Function    :   Frame files and recently displayed frames
+* | Info        :
+*                A frame file holds the black and the red image and the
+*                same frame in the controller format. It is mapped in
+*                memory, so the frame can be sent to the panel without
+*                drawing or packing it again.
+*
+*                The packed frames of the last EPD_PACKED_CACHE displayed
+*                images are kept, showing one of those again needs no
+*                packing.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __EPD_FRAME_H
+#define __EPD_FRAME_H
+
+#include "DEV_Config.h"
+#include <stddef.h>
+
+/**
+ * Frame file, numbers are little endian
+ *
+ *  EPD_FRAME_HEADER
+ *  black image : Plane_Bytes (1 bit per pixel, 0 = black)
+ *  red image   : Plane_Bytes (1 bit per pixel, 0 = red)
+ *  packed      : Frame_Bytes (EPD_PackPlanes() of both images)
+**/
+#define EPD_FRAME_MAGIC     "EPDF"
+
+typedef struct {
+    char     Magic[4];
+    uint16_t Width;
+    uint16_t Height;
+    uint32_t Plane_Bytes;
+    uint32_t Frame_Bytes;
+    uint64_t Hash;              // EPD_FrameHash() of both images
+    uint32_t Black;             // offset of the black image in the file
+    uint32_t Red;               // offset of the red image in the file
+    uint32_t Packed;            // offset of the packed frame in the file
+    uint32_t Reserved;
+} EPD_FRAME_HEADER;
+
+/**
+ * Opened frame file
+**/
+typedef struct {
+    const UBYTE *Black;
+    const UBYTE *Red;
+    const UBYTE *Packed;
+    uint64_t Hash;
+    void *Map;                  // NULL = not open
+    size_t Size;
+} EPD_FRAME;
+
+#define EPD_PACKED_CACHE    4       // packed frames kept
+
+UBYTE EPD_FrameSave(const char *File, const UBYTE *Imageblack, const UBYTE *Imagered);
+UBYTE EPD_FrameOpen(const char *File, EPD_FRAME *Frame);
+void EPD_FrameClose(EPD_FRAME *Frame);
+
+//recently displayed frames
+const UBYTE *EPD_PackedGet(uint64_t Hash, const UBYTE *Imageblack, const UBYTE *Imagered);
+void EPD_PackedStats(UDOUBLE *Hits, UDOUBLE *Misses);
+
+#endif
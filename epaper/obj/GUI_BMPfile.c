@@ -15,6 +15,12 @@
 *   and support the display of images of any size. If it is larger than 
 *   the actual display range, it will not be displayed.
 * 3.fix:line87  &bmprgbquad[i * 4] =》 &bmprgbquad[i]
+* 4.Change: GUI_ReadBmp() (agent)
+*   Reads a row at a time and writes it with Paint_DrawRowBits() instead
+*   of copying the image on the stack first. Supports 1, 4, 8 and 24 bit,
+*   a pixel is black below BMP_THRESHOLD.
+* 5.add: GUI_ReadBmpColor() (agent)
+*   Separates a BMP file in a black and a red image with dithering
 *
 * Permission is hereby granted, free of charge, to any person obtaining a copy
 * of this software and associated documnetation files (the "Software"), to deal
@@ -38,6 +44,7 @@
 
 #include "GUI_BMPfile.h"
 #include "GUI_Paint.h"
+#include "GUI_Dither.h"
 //#include "Debug.h"
 
 #include <fcntl.h>
@@ -45,90 +52,297 @@
 #include <stdint.h>
 #include <stdlib.h> //exit()
 #include <string.h> //memset()
-#include <math.h>   //memset()
 
-UBYTE GUI_ReadBmp(const char *path, UWORD Xstart, UWORD Ystart)
+/******************************************************************************
+function:   Dark (1) or light (0) for a color
+parameter:
+    Red, Green, Blue : intensity of the color
+******************************************************************************/
+static inline UBYTE GUI_BmpDark(UBYTE Red, UBYTE Green, UBYTE Blue)
+{
+    return (299 * Red + 587 * Green + 114 * Blue) / 1000 < BMP_THRESHOLD;
+}
+
+/******************************************************************************
+function:   Up to 64 pixels of a BMP row as bits, 1 = dark
+parameter:
+    Row      :   row as read from the file
+    BitCount :   bits per pixel (1, 4, 8 or 24)
+    X        :   first pixel
+    Width    :   number of pixels (max 64)
+    Dark     :   palette: 1 = dark color (1, 4 and 8 bit)
+Info:
+    first pixel in bit 63
+******************************************************************************/
+static uint64_t GUI_BmpRowBits(const UBYTE *Row, UWORD BitCount, UDOUBLE X, UWORD Width, const UBYTE *Dark)
+{
+    uint64_t Bits = 0, Raw = 0;
+    const UBYTE *p;
+    UWORD i;
+
+    switch (BitCount) {
+    case 1:
+        for (i = 0; i < (Width + 7) / 8; i++)
+            Raw |= (uint64_t) Row[X / 8 + i] << (56 - 8 * i);
+
+        if (Dark[1]) Bits |= Raw;
+        if (Dark[0]) Bits |= ~Raw;
+        break;
+
+    case 4:
+        for (i = 0; i < Width; i++) {
+            if (Dark[((X + i) % 2) ? Row[(X + i) / 2] & 0x0f : Row[(X + i) / 2] >> 4])
+                Bits |= (uint64_t) 1 << (63 - i);
+        }
+        break;
+
+    case 8:
+        for (i = 0; i < Width; i++) {
+            if (Dark[Row[X + i]]) Bits |= (uint64_t) 1 << (63 - i);
+        }
+        break;
+
+    default:            // 24 bit: blue, green, red
+        for (i = 0, p = &Row[X * 3]; i < Width; i++, p += 3) {
+            if (GUI_BmpDark(p[2], p[1], p[0])) Bits |= (uint64_t) 1 << (63 - i);
+        }
+        break;
+    }
+
+    return (Width < 64) ? Bits & ~(~(uint64_t) 0 >> Width) : Bits;
+}
+
+/******************************************************************************
+function:   Open a BMP file and read the headers and palette
+parameter:
+    path     :   BMP file
+    Bmp      :   filled with the file properties
+Info:
+    return 0 = OK, 1 = error
+******************************************************************************/
+static UBYTE GUI_BmpOpen(const char *path, BMPFILE *Bmp)
 {
-    FILE *fp;                     //Define a file pointer
-    BMPFILEHEADER bmpFileHeader;  //Define a bmp file header structure
     BMPINFOHEADER bmpInfoHeader;  //Define a bmp info header structure
-    
+    UDOUBLE Colors;
 
     // Binary file open
-    if((fp = fopen(path, "rb")) == NULL) {
+    if((Bmp->fp = fopen(path, "rb")) == NULL) {
         Debug("Cann't open the file!\n");
-        //exit(0);
         return(1);
     }
 
-    // Set the file pointer from the beginning
-    fseek(fp, 0, SEEK_SET);
-    fread(&bmpFileHeader, sizeof(BMPFILEHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 14
-    fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, fp);    //sizeof(BMPFILEHEADER) must be 50
-    //printf("pixel = %d * %d\r\n", bmpInfoHeader.biWidth, bmpInfoHeader.biHeight);
-    
-    UWORD Image_Width_Byte = (bmpInfoHeader.biWidth % 8 == 0)? (bmpInfoHeader.biWidth / 8): (bmpInfoHeader.biWidth / 8 + 1);
-    UWORD Bmp_Width_Byte = (Image_Width_Byte % 4 == 0) ? Image_Width_Byte: ((Image_Width_Byte / 4 + 1) * 4);    
-    UBYTE Image[Image_Width_Byte * bmpInfoHeader.biHeight];
-    memset(Image, 0xFF, Image_Width_Byte * bmpInfoHeader.biHeight);
-    
-    // Determine if it is a monochrome bitmap
-    int readbyte = bmpInfoHeader.biBitCount;
-    if(readbyte != 1){
-        Debug("the bmp Image is not a monochrome bitmap!\n");
-        //exit(0);
-        return(1);
+    if (fread(&Bmp->FileHeader, sizeof(BMPFILEHEADER), 1, Bmp->fp) != 1 ||
+        fread(&bmpInfoHeader, sizeof(BMPINFOHEADER), 1, Bmp->fp) != 1 ||
+        Bmp->FileHeader.bType != 0x4D42 || bmpInfoHeader.biInfoSize < sizeof(BMPINFOHEADER)) {
+        Debug("the file is not a bmp Image!\n");
+        goto error;
     }
-    
-    // Determine black and white based on the palette
-    UWORD i;
-    UWORD Bcolor, Wcolor;
-    UWORD bmprgbquadsize = pow(2, bmpInfoHeader.biBitCount);// 2^1 = 2
-    BMPRGBQUAD bmprgbquad[bmprgbquadsize];        //palette
-    
-    for(i = 0; i < bmprgbquadsize; i++){
-        // fread(&bmprgbquad[i * 4], sizeof(BMPRGBQUAD), 1, fp);
-        fread(&bmprgbquad[i], sizeof(BMPRGBQUAD), 1, fp);
+
+    if (bmpInfoHeader.biCompression != 0) {
+        Debug("the bmp Image is compressed!\n");
+        goto error;
     }
-    if(bmprgbquad[0].rgbBlue == 0xff && bmprgbquad[0].rgbGreen == 0xff && bmprgbquad[0].rgbRed == 0xff){
-        Bcolor = BLACK;
-        Wcolor = WHITE;
-    }else{
-        Bcolor = WHITE;
-        Wcolor = BLACK;
+
+    switch (bmpInfoHeader.biBitCount) {
+    case 1: case 4: case 8: case 24:
+        break;
+    default:
+        Debug("the bmp Image has %d bits per pixel, supported are 1, 4, 8 and 24\n", bmpInfoHeader.biBitCount);
+        goto error;
     }
-    
-    // Read image data into the cache
-    UWORD x, y;
-    UBYTE Rdata; 
-    fseek(fp, bmpFileHeader.bOffset, SEEK_SET);
-    for(y = 0; y < bmpInfoHeader.biHeight; y++) {//Total display column
-        for(x = 0; x < Bmp_Width_Byte; x++) {//Show a line in the line
-            if(fread((char *)&Rdata, 1, readbyte, fp) != readbyte) {
-                perror("get bmpdata:\r\n");
-                break;
-            }
-            if(x < Image_Width_Byte) { //bmp
-                Image[x + (bmpInfoHeader.biHeight - y - 1) * Image_Width_Byte] =  Rdata;
-                // printf("rdata = %d\r\n", Rdata);
-            }
-        }
-    }    
-    fclose(fp);
-    
-    // Refresh the image to the display buffer based on the displayed orientation
-    UBYTE color, temp;
-    for(y = 0; y < bmpInfoHeader.biHeight; y++){
-        for(x = 0; x < bmpInfoHeader.biWidth; x++){
-            if(x > Paint.Width || y > Paint.Height){
-                break;
-            }
-            temp = Image[(x / 8) + (y * Image_Width_Byte)];
-            color = (((temp << (x%8)) & 0x80) == 0x80) ?Bcolor:Wcolor;      
-            Paint_SetPixel(Xstart + x, Ystart + y, color);
+
+    // a negative height is a top-down bitmap
+    Bmp->TopDown = (int32_t) bmpInfoHeader.biHeight < 0;
+    Bmp->Width = bmpInfoHeader.biWidth;
+    Bmp->Height = Bmp->TopDown ? (UDOUBLE) -(int64_t) (int32_t) bmpInfoHeader.biHeight : bmpInfoHeader.biHeight;
+    Bmp->BitCount = bmpInfoHeader.biBitCount;
+
+    if (Bmp->Width == 0 || Bmp->Width > 0xffff || Bmp->Height == 0 || Bmp->Height > 0xffff) {
+        Debug("the bmp Image has an invalid size!\n");
+        goto error;
+    }
+
+    // rows are a multiple of 4 bytes
+    Bmp->Row_Bytes = ((Bmp->Width * Bmp->BitCount + 31) / 32) * 4;
+
+    // palette, a missing color is black
+    memset(Bmp->Palette, 0x0, sizeof(Bmp->Palette));
+
+    if (Bmp->BitCount <= 8) {
+        Colors = bmpInfoHeader.biClrUsed ? bmpInfoHeader.biClrUsed : 1U << Bmp->BitCount;
+        if (Colors > 1U << Bmp->BitCount) Colors = 1U << Bmp->BitCount;
+
+        fseek(Bmp->fp, sizeof(BMPFILEHEADER) + bmpInfoHeader.biInfoSize, SEEK_SET);
+        if (fread(Bmp->Palette, sizeof(BMPRGBQUAD), Colors, Bmp->fp) != Colors)
+            Debug("the bmp Image palette is incomplete\n");
+    }
+
+    return 0;
+
+error:
+    fclose(Bmp->fp);
+    return 1;
+}
+
+/******************************************************************************
+function:   Read a row of a BMP file
+parameter:
+    Bmp      :   opened BMP file
+    y        :   row, 0 is the top row
+    Row      :   buffer of Row_Bytes
+Info:
+    return 0 = OK, 1 = error
+******************************************************************************/
+static UBYTE GUI_BmpReadRow(BMPFILE *Bmp, UDOUBLE y, UBYTE *Row)
+{
+    UDOUBLE Line = Bmp->TopDown ? y : Bmp->Height - y - 1;
+
+    if (fseek(Bmp->fp, Bmp->FileHeader.bOffset + Line * Bmp->Row_Bytes, SEEK_SET) != 0 ||
+        fread(Row, 1, Bmp->Row_Bytes, Bmp->fp) != Bmp->Row_Bytes) {
+        perror("get bmpdata:\r\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+function:   Show a BMP file in the selected image
+parameter:
+    path     :   BMP file
+    Xstart   :   X of the top left corner
+    Ystart   :   Y of the top left corner
+Info:
+    Uncompressed 1, 4, 8 and 24 bit BMP. A pixel is black if the
+    brightness of its color is below BMP_THRESHOLD, else white.
+    The file is read a row at a time and each row is written with
+    Paint_DrawRowBits(). The part outside the image is not shown.
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE GUI_ReadBmp(const char *path, UWORD Xstart, UWORD Ystart)
+{
+    BMPFILE Bmp;
+    UBYTE Dark[256], *Row;
+    UDOUBLE i, x, y, Width, Height;
+    uint64_t Bits;
+    UWORD n;
+
+    if (GUI_BmpOpen(path, &Bmp)) return(1);
+
+    // Determine black and white based on the palette
+    for (i = 0; i < 256; i++)
+        Dark[i] = GUI_BmpDark(Bmp.Palette[i].rgbRed, Bmp.Palette[i].rgbGreen, Bmp.Palette[i].rgbBlue);
+
+    if ((Row = (UBYTE *) malloc(Bmp.Row_Bytes)) == NULL) {
+        Debug("no memory for a bmp row\n");
+        fclose(Bmp.fp);
+        return(1);
+    }
+
+    // part that is on the image
+    Width = Bmp.Width;
+    Height = Bmp.Height;
+    if (Xstart >= Paint.Width || Ystart >= Paint.Height) Width = Height = 0;
+    if (Width > (UDOUBLE) (Paint.Width - Xstart)) Width = Paint.Width - Xstart;
+    if (Height > (UDOUBLE) (Paint.Height - Ystart)) Height = Paint.Height - Ystart;
+
+    for (y = 0; y < Height; y++) {
+
+        if (GUI_BmpReadRow(&Bmp, y, Row)) break;
+
+        for (x = 0; x < Width; x += 64) {
+            n = (Width - x > 64) ? 64 : Width - x;
+            Bits = GUI_BmpRowBits(Row, Bmp.BitCount, x, n, Dark);
+
+            Paint_DrawRowBits(Paint.Image, Xstart + x, Ystart + y, Bits, n, BLACK);
+            Paint_DrawRowBits(Paint.Image, Xstart + x, Ystart + y, ~Bits, n, WHITE);
         }
     }
+
+    free(Row);
+    fclose(Bmp.fp);
     return 0;
 }
 
+/******************************************************************************
+function:   Show a BMP file separated in a black and a red image
+parameter:
+    path     :   BMP file
+    Xstart   :   X of the top left corner
+    Ystart   :   Y of the top left corner
+    Black    :   black image
+    Red      :   red image
+    Mode     :   DITHER_NEAREST, DITHER_FLOYD or DITHER_ORDERED
+Info:
+    Uncompressed 1, 4, 8 and 24 bit BMP. Every pixel becomes white, black
+    or red, see GUI_Dither.c. The rows are read and dithered top to bottom,
+    one at a time. The part outside the image is not shown.
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE GUI_ReadBmpColor(const char *path, UWORD Xstart, UWORD Ystart, UBYTE *Black, UBYTE *Red, UBYTE Mode)
+{
+    BMPFILE Bmp;
+    DITHER Dither;
+    UBYTE *Row = NULL, *RGB = NULL, *Index = NULL, *p, Pixel;
+    UDOUBLE x, y, Width, Height;
+    UBYTE ret = 1;
+
+    if (GUI_BmpOpen(path, &Bmp)) return(1);
+
+    // part that is on the image
+    Width = Bmp.Width;
+    Height = Bmp.Height;
+    if (Xstart >= Paint.Width || Ystart >= Paint.Height) Width = Height = 0;
+    if (Width > (UDOUBLE) (Paint.Width - Xstart)) Width = Paint.Width - Xstart;
+    if (Height > (UDOUBLE) (Paint.Height - Ystart)) Height = Paint.Height - Ystart;
+
+    if (Width == 0) {
+        fclose(Bmp.fp);
+        return(0);
+    }
+
+    Row = (UBYTE *) malloc(Bmp.Row_Bytes);
+    RGB = (UBYTE *) malloc(Width * 3);
+    Index = (UBYTE *) malloc(Width);
+
+    if (Row == NULL || RGB == NULL || Index == NULL || Dither_Init(&Dither, Width, Mode)) {
+        Debug("no memory for a bmp row\n");
+        goto exit;
+    }
+
+    for (y = 0; y < Height; y++) {
 
+        if (GUI_BmpReadRow(&Bmp, y, Row)) break;
+
+        // as R, G, B
+        for (x = 0, p = RGB; x < Width; x++, p += 3) {
+            if (Bmp.BitCount == 24) {
+                p[0] = Row[x * 3 + 2];
+                p[1] = Row[x * 3 + 1];
+                p[2] = Row[x * 3];
+                continue;
+            }
+
+            if (Bmp.BitCount == 8) Pixel = Row[x];
+            else if (Bmp.BitCount == 4) Pixel = (x % 2) ? Row[x / 2] & 0x0f : Row[x / 2] >> 4;
+            else Pixel = (Row[x / 8] >> (7 - x % 8)) & 0x1;
+
+            p[0] = Bmp.Palette[Pixel].rgbRed;
+            p[1] = Bmp.Palette[Pixel].rgbGreen;
+            p[2] = Bmp.Palette[Pixel].rgbBlue;
+        }
+
+        Dither_Row(&Dither, RGB, 3, Index);
+        Dither_DrawRow(Black, Red, Xstart, Ystart + y, Index, Width);
+    }
+
+    Dither_Exit(&Dither);
+    ret = 0;
+
+exit:
+    free(Row);
+    free(RGB);
+    free(Index);
+    fclose(Bmp.fp);
+    return ret;
+}
@@ -14,6 +14,10 @@
 *   Now Xstart and Xstart can control the position of the picture normally, 
 *   and support the display of images of any size. If it is larger than 
 *   the actual display range, it will not be displayed.
+* 3.Change: GUI_ReadBmp() (agent)
+*   Reads a row at a time, supports 1, 4, 8 and 24 bit
+* 4.add: GUI_ReadBmpColor() (agent)
+*   Separates a BMP file in a black and a red image with dithering
 #
 # Permission is hereby granted, free of charge, to any person obtaining a copy
 # of this software and associated documnetation files (the "Software"), to deal
@@ -44,6 +48,9 @@
 
 #include "DEV_Config.h"
 
+/* brightness (0 - 255) below which a pixel is black */
+#define BMP_THRESHOLD   128
+
 /*Bitmap file header   14bit*/
 typedef struct BMP_FILE_HEADER {
     UWORD bType;        //File identifier
@@ -75,7 +82,20 @@ typedef struct RGB_QUAD {
     UBYTE rgbRed;                //Red intensity
     UBYTE rgbReversed;           //Reserved value
 } __attribute__ ((packed)) BMPRGBQUAD;
+
+/*Opened bmp file */
+typedef struct {
+    FILE *fp;
+    BMPFILEHEADER FileHeader;
+    UDOUBLE Width;
+    UDOUBLE Height;
+    UDOUBLE Row_Bytes;           //bytes in a row, including padding
+    UWORD BitCount;
+    UBYTE TopDown;               //1 = first row in the file is the top row
+    BMPRGBQUAD Palette[256];
+} BMPFILE;
 /**************************************** end ***********************************************/
 
 UBYTE GUI_ReadBmp(const char *path, UWORD Xstart, UWORD Ystart);
+UBYTE GUI_ReadBmpColor(const char *path, UWORD Xstart, UWORD Ystart, UBYTE *Black, UBYTE *Red, UBYTE Mode);
 #endif
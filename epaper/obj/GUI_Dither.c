@@ -0,0 +1,214 @@
+/*****************************************************************************
+* | File        :   GUI_Dither.c
+* | Author      :   agent
+* | Function    :   Separate a color or grey image in black, white and red
+* | Info        :
+*                Every pixel is set to the nearest of the panel colors, the
+*                difference is spread over the next pixels (Floyd-Steinberg)
+*                or a threshold pattern is added first (ordered). Works a
+*                row at a time with integer math, the error is kept in
+*                1/16 steps.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#include "GUI_Dither.h"
+#include "GUI_Paint.h"
+# include <stdlib.h>
+# include <string.h>
+
+/* panel colors as R, G, B (index DITHER_xxx) */
+static const UBYTE Dither_Palette[3][3] = {
+    {0xff, 0xff, 0xff},
+    {0x00, 0x00, 0x00},
+    {0xff, 0x00, 0x00}
+};
+
+/* 8x8 Bayer matrix, 0 - 63 */
+static const UBYTE Dither_Bayer[8][8] = {
+    { 0, 32,  8, 40,  2, 34, 10, 42},
+    {48, 16, 56, 24, 50, 18, 58, 26},
+    {12, 44,  4, 36, 14, 46,  6, 38},
+    {60, 28, 52, 20, 62, 30, 54, 22},
+    { 3, 35, 11, 43,  1, 33,  9, 41},
+    {51, 19, 59, 27, 49, 17, 57, 25},
+    {15, 47,  7, 39, 13, 45,  5, 37},
+    {63, 31, 55, 23, 61, 29, 53, 21}
+};
+
+/******************************************************************************
+function:   Nearest panel color
+parameter:
+    Red, Green, Blue : color, 0 - 255
+Info:
+    return DITHER_WHITE, DITHER_BLACK or DITHER_RED
+******************************************************************************/
+static UBYTE Dither_Nearest(int Red, int Green, int Blue)
+{
+    int32_t Dist, Best = INT32_MAX;
+    UBYTE i, Index = DITHER_WHITE;
+
+    for (i = 0; i < 3; i++) {
+        Dist = (Red - Dither_Palette[i][0]) * (Red - Dither_Palette[i][0]) +
+               (Green - Dither_Palette[i][1]) * (Green - Dither_Palette[i][1]) +
+               (Blue - Dither_Palette[i][2]) * (Blue - Dither_Palette[i][2]);
+
+        if (Dist < Best) {
+            Best = Dist;
+            Index = i;
+        }
+    }
+
+    return Index;
+}
+
+static inline int Dither_Clip(int Value)
+{
+    return Value < 0 ? 0 : (Value > 255 ? 255 : Value);
+}
+
+/******************************************************************************
+function:   Start a new image
+parameter:
+    Dither  :   state to initialise
+    Width   :   pixels in a row
+    Mode    :   DITHER_NEAREST, DITHER_FLOYD or DITHER_ORDERED
+Info:
+    return 0 = OK, 1 = no memory
+******************************************************************************/
+UBYTE Dither_Init(DITHER *Dither, UWORD Width, UBYTE Mode)
+{
+    Dither->Mode = Mode;
+    Dither->Width = Width;
+    Dither->Line = 0;
+    Dither->Error = NULL;
+
+    if (Mode == DITHER_FLOYD) {
+        Dither->Error = (int16_t *) calloc(2 * (Width + 2) * 3, sizeof(int16_t));
+        if (Dither->Error == NULL) return 1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+function:   Separate the next row of the image
+parameter:
+    Dither   :   state
+    Pixels   :   Width pixels of Channels bytes (3 = R, G, B or 1 = grey)
+    Channels :   1 or 3
+    Index    :   Width bytes: DITHER_WHITE, DITHER_BLACK or DITHER_RED
+Info:
+    Rows must be given top to bottom
+******************************************************************************/
+void Dither_Row(DITHER *Dither, const UBYTE *Pixels, UBYTE Channels, UBYTE *Index)
+{
+    int16_t *Cur = NULL, *Next = NULL;
+    int Value[3], Offset, e;
+    UWORD x;
+    UBYTE c, i;
+
+    if (Dither->Mode == DITHER_FLOYD) {
+        Cur = Dither->Error + (Dither->Line % 2) * (Dither->Width + 2) * 3;
+        Next = Dither->Error + ((Dither->Line + 1) % 2) * (Dither->Width + 2) * 3;
+    }
+
+    for (x = 0; x < Dither->Width; x++, Pixels += Channels) {
+
+        for (c = 0; c < 3; c++)
+            Value[c] = Pixels[Channels == 3 ? c : 0];
+
+        if (Dither->Mode == DITHER_FLOYD) {
+            for (c = 0; c < 3; c++)
+                Value[c] = Dither_Clip(Value[c] + ((Cur[(x + 1) * 3 + c] + 8) >> 4));
+        }
+        else if (Dither->Mode == DITHER_ORDERED) {
+            // -126 to +126
+            Offset = ((2 * Dither_Bayer[Dither->Line % 8][x % 8] - 63) * 255) >> 7;
+            for (c = 0; c < 3; c++)
+                Value[c] = Dither_Clip(Value[c] + Offset);
+        }
+
+        i = Dither_Nearest(Value[0], Value[1], Value[2]);
+        Index[x] = i;
+
+        if (Dither->Mode == DITHER_FLOYD) {
+            // 7/16 right, 3/16 left below, 5/16 below, 1/16 right below
+            for (c = 0; c < 3; c++) {
+                e = Value[c] - Dither_Palette[i][c];
+                Cur[(x + 2) * 3 + c] += e * 7;
+                Next[x * 3 + c] += e * 3;
+                Next[(x + 1) * 3 + c] += e * 5;
+                Next[(x + 2) * 3 + c] += e;
+            }
+        }
+    }
+
+    // this row becomes the row after next
+    if (Dither->Mode == DITHER_FLOYD)
+        memset(Cur, 0x0, (Dither->Width + 2) * 3 * sizeof(int16_t));
+
+    Dither->Line++;
+}
+
+/******************************************************************************
+function:   Draw a separated row in the black and red image
+parameter:
+    Black   :   black image
+    Red     :   red image
+    Xpoint  :   X of the first pixel
+    Ypoint  :   At point Y
+    Index   :   Width bytes: DITHER_WHITE, DITHER_BLACK or DITHER_RED
+    Width   :   number of pixels
+******************************************************************************/
+void Dither_DrawRow(UBYTE *Black, UBYTE *Red, UWORD Xpoint, UWORD Ypoint, const UBYTE *Index, UWORD Width)
+{
+    uint64_t Bits_Black, Bits_Red, Fill;
+    UWORD x, n, i;
+
+    for (x = 0; x < Width; x += 64) {
+        n = (Width - x > 64) ? 64 : Width - x;
+        Fill = (n < 64) ? ~(~(uint64_t) 0 >> n) : ~(uint64_t) 0;
+
+        Bits_Black = Bits_Red = 0;
+        for (i = 0; i < n; i++) {
+            if (Index[x + i] == DITHER_BLACK) Bits_Black |= (uint64_t) 1 << (63 - i);
+            else if (Index[x + i] == DITHER_RED) Bits_Red |= (uint64_t) 1 << (63 - i);
+        }
+
+        Paint_DrawRowBits(Black, Xpoint + x, Ypoint, Bits_Black, n, BLACK);
+        Paint_DrawRowBits(Black, Xpoint + x, Ypoint, ~Bits_Black & Fill, n, WHITE);
+        Paint_DrawRowBits(Red, Xpoint + x, Ypoint, Bits_Red, n, RED);
+        Paint_DrawRowBits(Red, Xpoint + x, Ypoint, ~Bits_Red & Fill, n, WHITE);
+    }
+}
+
+/******************************************************************************
+function:   Release the state
+parameter:
+    Dither  :   state
+******************************************************************************/
+void Dither_Exit(DITHER *Dither)
+{
+    free(Dither->Error);
+    Dither->Error = NULL;
+}
@@ -0,0 +1,65 @@
+/*****************************************************************************
+* | File        :   GUI_Dither.h
+* | Author      :   agent
+* | Function    :   Separate a color or grey image in black, white and red
+* | Info        :
+*                Every pixel is set to the nearest of the panel colors, the
+*                difference is spread over the next pixels (Floyd-Steinberg)
+*                or a threshold pattern is added first (ordered). Works a
+*                row at a time with integer math.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __GUI_DITHER_H
+#define __GUI_DITHER_H
+
+#include "DEV_Config.h"
+
+/**
+ * Dither mode
+**/
+#define DITHER_NONE     0       // black and white threshold (GUI_ReadBmp)
+#define DITHER_NEAREST  1       // nearest panel color
+#define DITHER_FLOYD    2       // Floyd-Steinberg error diffusion
+#define DITHER_ORDERED  3       // 8x8 Bayer pattern
+
+/**
+ * Panel color of a pixel
+**/
+#define DITHER_WHITE    0
+#define DITHER_BLACK    1
+#define DITHER_RED      2
+
+typedef struct {
+    UBYTE Mode;
+    UWORD Width;
+    UWORD Line;                 // rows done
+    int16_t *Error;             // DITHER_FLOYD: 2 rows of (Width + 2) x 3
+} DITHER;
+
+UBYTE Dither_Init(DITHER *Dither, UWORD Width, UBYTE Mode);
+void Dither_Row(DITHER *Dither, const UBYTE *Pixels, UBYTE Channels, UBYTE *Index);
+void Dither_DrawRow(UBYTE *Black, UBYTE *Red, UWORD Xpoint, UWORD Ypoint, const UBYTE *Index, UWORD Width);
+void Dither_Exit(DITHER *Dither);
+
+#endif
@@ -0,0 +1,361 @@
+/*****************************************************************************
+* | File        :   GUI_Fonts.c
+* | Author      :   agent
+* | Function    :   Registry of the fonts that can be selected by name
+* | Info        :
+*                The fonts in the Fonts directory are registered on first
+*                use. More fonts can be added with Font_Register().
+*                A name is resolved once when the font is selected, so no
+*                lookup is needed when text is drawn.
+*
+*                A font that is not registered is loaded from a binary font
+*                file (name.epf) in the font directory. The file is mapped in
+*                memory, so only the glyphs that are used are read. A
+*                registered font can be written as binary font file with
+*                Font_Save().
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#define _DEFAULT_SOURCE          // le16toh() and friends
+#include "GUI_Fonts.h"
+# include <stdlib.h>
+# include <string.h>
+# include <strings.h>    // strcasecmp()
+# include <endian.h>     // le16toh()
+# include <fcntl.h>      // open()
+# include <unistd.h>     // close()
+# include <sys/mman.h>   // mmap()
+# include <sys/stat.h>   // fstat()
+
+static FONT_ENTRY Font_Table[FONT_MAX];
+static UBYTE Font_Count = 0;
+static UBYTE Font_Builtin = 0;
+
+/* directory with the binary font files */
+static char Font_Dir[100] = FONT_DIR_DFT;
+
+/******************************************************************************
+function:   Register the fonts in the Fonts directory
+parameter:
+Info:
+    if you add a font to the Fonts directory, update fonts.h and add it here
+******************************************************************************/
+static void Font_Init(void)
+{
+    if (Font_Builtin) return;
+    Font_Builtin = 1;
+
+    Font_Register("font8", &Font8, NULL);
+    Font_Register("font12", &Font12, NULL);
+    Font_Register("font12CN", NULL, &Font12CN);
+    Font_Register("font16", &Font16, NULL);
+    Font_Register("font20", &Font20, NULL);
+    Font_Register("font24", &Font24, NULL);
+    Font_Register("font24CN", NULL, &Font24CN);
+}
+
+/******************************************************************************
+function:   Add a font to the registry
+parameter:
+    Name    :   name to select the font with (not case sensitive)
+    Font    :   ASCII font or NULL
+    FontCN  :   GB2312 font or NULL
+Info:
+    A font that is already registered with the same name is replaced
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE Font_Register(const char *Name, sFONT *Font, cFONT *FontCN)
+{
+    FONT_ENTRY *Entry;
+    UBYTE Num;
+
+    Font_Init();
+
+    if ((Font == NULL) == (FontCN == NULL)) {
+        Debug("font %s: need either a font or a CN font\r\n", Name);
+        return 1;
+    }
+
+    if (strlen(Name) == 0 || strlen(Name) >= FONT_NAME_MAX) {
+        Debug("font name %s: invalid length\r\n", Name);
+        return 1;
+    }
+
+    for (Num = 0; Num < Font_Count; Num++) {
+        if (strcasecmp(Font_Table[Num].Name, Name) == 0) break;
+    }
+
+    if (Num == Font_Count) {
+        if (Font_Count == FONT_MAX) {
+            Debug("font %s: registry is full\r\n", Name);
+            return 1;
+        }
+        Font_Count++;
+    }
+
+    Entry = &Font_Table[Num];
+    strcpy(Entry->Name, Name);
+    Entry->Font = Font;
+    Entry->FontCN = FontCN;
+
+    Debug("font %s registered\r\n", Name);
+    return 0;
+}
+
+/******************************************************************************
+function:   Find a font by name
+parameter:
+    Name    :   name of the font (not case sensitive)
+Info:
+    If the font is not registered, it is loaded from name.epf in the
+    font directory.
+    return NULL if the font is not registered and can not be loaded
+******************************************************************************/
+const FONT_ENTRY *Font_Find(const char *Name)
+{
+    char File[sizeof(Font_Dir) + FONT_NAME_MAX + sizeof(FONT_EXT)];
+    UBYTE Num;
+
+    Font_Init();
+
+    for (Num = 0; Num < Font_Count; Num++) {
+        if (strcasecmp(Font_Table[Num].Name, Name) == 0)
+            return &Font_Table[Num];
+    }
+
+    // not registered: try the binary font file
+    if (strlen(Name) == 0 || strlen(Name) >= FONT_NAME_MAX || strchr(Name, '/'))
+        return NULL;
+
+    sprintf(File, "%s%s%s", Font_Dir, Name, FONT_EXT);
+
+    if (Font_Load(Name, File)) return NULL;
+
+    return &Font_Table[Font_Count - 1];
+}
+
+/******************************************************************************
+function:   Get a registered font
+parameter:
+    Num     :   number of the font, starting at 0
+Info:
+    return NULL after the last font
+******************************************************************************/
+const FONT_ENTRY *Font_Get(UBYTE Num)
+{
+    Font_Init();
+
+    return Num < Font_Count ? &Font_Table[Num] : NULL;
+}
+
+/******************************************************************************
+function:   Set the directory with binary font files
+parameter:
+    Dir     :   directory, a '/' is added if needed
+Info:
+******************************************************************************/
+void Font_SetDir(const char *Dir)
+{
+    size_t Len;
+
+    strncpy(Font_Dir, Dir, sizeof(Font_Dir) - 2);
+    Font_Dir[sizeof(Font_Dir) - 2] = 0x0;
+
+    Len = strlen(Font_Dir);
+    if (Len > 0 && Font_Dir[Len - 1] != '/') strcat(Font_Dir, "/");
+
+    Debug("font directory set to %s\r\n", Font_Dir);
+}
+
+/******************************************************************************
+function:   Load a binary font file
+parameter:
+    Name    :   name to register the font with
+    File    :   binary font file (.epf)
+Info:
+    The file is mapped in memory and stays mapped, the font uses the
+    glyphs in the mapping directly.
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE Font_Load(const char *Name, const char *File)
+{
+    FONT_EPF_HEADER Header;
+    struct stat st;
+    const uint8_t *Map;
+    uint64_t Glyph_Bytes;
+    sFONT *Font = NULL;
+    cFONT *FontCN = NULL;
+    int fd;
+
+    if ((fd = open(File, O_RDONLY)) < 0) {
+        Debug("can not open font file %s\r\n", File);
+        return 1;
+    }
+
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(FONT_EPF_HEADER)) {
+        printf("font file %s is too short\r\n", File);
+        close(fd);
+        return 1;
+    }
+
+    Map = (const uint8_t *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (Map == MAP_FAILED) {
+        printf("can not map font file %s\r\n", File);
+        return 1;
+    }
+
+    memcpy(&Header, Map, sizeof(Header));
+    Header.Width = le16toh(Header.Width);
+    Header.Height = le16toh(Header.Height);
+    Header.ASCII_Width = le16toh(Header.ASCII_Width);
+    Header.Count = le32toh(Header.Count);
+    Header.Index = le32toh(Header.Index);
+    Header.Bitmap = le32toh(Header.Bitmap);
+
+    Glyph_Bytes = (uint64_t) Header.Height * (Header.Width / 8 + (Header.Width % 8 ? 1 : 0));
+
+    if (memcmp(Header.Magic, FONT_EPF_MAGIC, sizeof(Header.Magic)) != 0 ||
+        Header.Width == 0 || Header.Height == 0 ||
+        (uint64_t) Header.Bitmap + Glyph_Bytes * Header.Count > (uint64_t) st.st_size)
+        goto invalid;
+
+    if (Header.Type == FONT_EPF_ASCII) {
+
+        if (Header.Count != FONT_EPF_ASCII_COUNT) goto invalid;
+
+        if ((Font = (sFONT *) calloc(1, sizeof(sFONT))) == NULL) goto nomem;
+
+        Font->table = Map + Header.Bitmap;
+        Font->Width = Header.Width;
+        Font->Height = Header.Height;
+    }
+    else if (Header.Type == FONT_EPF_CN) {
+
+        if (Header.Count == 0 || Header.Count > UINT16_MAX ||
+            (uint64_t) Header.Index + 2 * (uint64_t) Header.Count > (uint64_t) st.st_size)
+            goto invalid;
+
+        if ((FontCN = (cFONT *) calloc(1, sizeof(cFONT))) == NULL) goto nomem;
+
+        FontCN->size = Header.Count;
+        FontCN->ASCII_Width = Header.ASCII_Width;
+        FontCN->Width = Header.Width;
+        FontCN->Height = Header.Height;
+        FontCN->codes = Map + Header.Index;
+        FontCN->bitmap = Map + Header.Bitmap;
+    }
+    else
+        goto invalid;
+
+    if (Font_Register(Name, Font, FontCN) == 0) {
+        Debug("font %s loaded from %s, %d glyphs\r\n", Name, File, Header.Count);
+        return 0;
+    }
+
+    free(Font);
+    free(FontCN);
+    munmap((void *) Map, st.st_size);
+    return 1;
+
+invalid:
+    printf("font file %s is not a valid font\r\n", File);
+    munmap((void *) Map, st.st_size);
+    return 1;
+
+nomem:
+    printf("no memory for font %s\r\n", Name);
+    munmap((void *) Map, st.st_size);
+    return 1;
+}
+
+/******************************************************************************
+function:   Write a registered font as binary font file
+parameter:
+    Entry   :   registered font
+    File    :   binary font file (.epf) to create
+Info:
+    return 0 = OK, 1 = error
+******************************************************************************/
+UBYTE Font_Save(const FONT_ENTRY *Entry, const char *File)
+{
+    FONT_EPF_HEADER Header;
+    UWORD Width, Height;
+    uint32_t Count, Num, Glyph_Bytes;
+    const unsigned char *Code, *Glyph;
+    FILE *fp;
+
+    if (Entry->Font) {
+        Width = Entry->Font->Width;
+        Height = Entry->Font->Height;
+        Count = FONT_EPF_ASCII_COUNT;
+    }
+    else {
+        Width = Entry->FontCN->Width;
+        Height = Entry->FontCN->Height;
+        Count = Entry->FontCN->size;
+    }
+
+    Glyph_Bytes = Height * (Width / 8 + (Width % 8 ? 1 : 0));
+
+    memset(&Header, 0x0, sizeof(Header));
+    memcpy(Header.Magic, FONT_EPF_MAGIC, sizeof(Header.Magic));
+    Header.Type = Entry->Font ? FONT_EPF_ASCII : FONT_EPF_CN;
+    Header.Width = htole16(Width);
+    Header.Height = htole16(Height);
+    Header.ASCII_Width = htole16(Entry->Font ? Width : Entry->FontCN->ASCII_Width);
+    Header.Count = htole32(Count);
+    Header.Index = htole32(Entry->Font ? 0 : sizeof(Header));
+    Header.Bitmap = htole32(sizeof(Header) + (Entry->Font ? 0 : Count * 2));
+
+    if ((fp = fopen(File, "wb")) == NULL) {
+        printf("can not create font file %s\r\n", File);
+        return 1;
+    }
+
+    fwrite(&Header, sizeof(Header), 1, fp);
+
+    if (Entry->Font)
+        fwrite(Entry->Font->table, Glyph_Bytes, Count, fp);
+    else {
+        for (Num = 0; Num < Count; Num++) {
+            Code = Entry->FontCN->table ? Entry->FontCN->table[Num].index : &Entry->FontCN->codes[Num * 2];
+            fwrite(Code, 2, 1, fp);
+        }
+
+        for (Num = 0; Num < Count; Num++) {
+            Glyph = Entry->FontCN->table ? (const unsigned char *) Entry->FontCN->table[Num].matrix
+                                         : &Entry->FontCN->bitmap[Num * Glyph_Bytes];
+            fwrite(Glyph, Glyph_Bytes, 1, fp);
+        }
+    }
+
+    if (ferror(fp) | fclose(fp)) {
+        printf("error writing font file %s\r\n", File);
+        return 1;
+    }
+
+    Debug("font %s written to %s\r\n", Entry->Name, File);
+    return 0;
+}
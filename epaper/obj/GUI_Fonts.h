@@ -0,0 +1,91 @@
+/*****************************************************************************
+* | File        :   GUI_Fonts.h
+* | Author      :   agent
+* | Function    :   Registry of the fonts that can be selected by name
+* | Info        :
+*                The fonts in the Fonts directory are registered on first
+*                use. More fonts can be added with Font_Register().
+*
+*                A font that is not registered is loaded from a binary font
+*                file (name.epf) in the font directory. The file is mapped in
+*                memory, so only the glyphs that are used are read.
+*----------------
+* | This version:   V1.0
+* | Date        :   2026-10-17
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documnetation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to  whom the Software is
+# furished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in
+# all copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+# THE SOFTWARE.
+#
+******************************************************************************/
+#ifndef __GUI_FONTS_H
+#define __GUI_FONTS_H
+
+#include "DEV_Config.h"
+#include "../Fonts/fonts.h"
+
+#define FONT_NAME_MAX   16      // including terminating 0x0
+#define FONT_MAX        32      // maximum number of registered fonts
+#define FONT_DIR_DFT    "./Fonts/"
+#define FONT_EXT        ".epf"
+
+/**
+ * Binary font file (.epf), numbers are little endian
+ *
+ *  EPF_HEADER
+ *  index   : FONT_EPF_CN only, 2 bytes GB2312 code per glyph
+ *            (ASCII: first byte the character, second byte 0)
+ *  bitmap  : per glyph Height rows of (Width + 7) / 8 bytes, MSB first
+ *
+ * FONT_EPF_ASCII has the glyphs for ' ' to '~' (FONT_EPF_ASCII_COUNT)
+**/
+#define FONT_EPF_MAGIC          "EPF1"
+#define FONT_EPF_ASCII          0
+#define FONT_EPF_CN             1
+#define FONT_EPF_ASCII_COUNT    ('~' - ' ' + 1)
+
+typedef struct {
+    char     Magic[4];
+    uint8_t  Type;              // FONT_EPF_ASCII or FONT_EPF_CN
+    uint8_t  Reserved;
+    uint16_t Width;
+    uint16_t Height;
+    uint16_t ASCII_Width;       // FONT_EPF_CN only
+    uint32_t Count;             // number of glyphs
+    uint32_t Index;             // offset of the index in the file
+    uint32_t Bitmap;            // offset of the bitmaps in the file
+} FONT_EPF_HEADER;
+
+/**
+ * Registered font, either Font (ASCII) or FontCN (GB2312) is set
+**/
+typedef struct {
+    char Name[FONT_NAME_MAX];
+    sFONT *Font;
+    cFONT *FontCN;
+} FONT_ENTRY;
+
+UBYTE Font_Register(const char *Name, sFONT *Font, cFONT *FontCN);
+const FONT_ENTRY *Font_Find(const char *Name);
+const FONT_ENTRY *Font_Get(UBYTE Num);
+
+//binary font file
+void Font_SetDir(const char *Dir);
+UBYTE Font_Load(const char *Name, const char *File);
+UBYTE Font_Save(const FONT_ENTRY *Entry, const char *File);
+
+#endif
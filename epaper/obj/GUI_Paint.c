@@ -24,6 +24,25 @@
 *    Can Mirroring the picture, horizontal, vertical, origin
 * 5.add: Paint_DrawString_CN() 
 *    Can display Chinese(GB1312)    
+* 6.add: Paint_GetDirty() / Paint_ClearDirty() (agent)
+*    Area of the images changed since the last display
+* 7.add: Paint_PixelWriter (agent)
+*    Pixel writer for the current rotate and mirror, selected once in
+*    Paint_NewImage(), Paint_SetRotate() and Paint_SetMirroring()
+* 8.add: Paint_DrawSpan() (agent)
+*    Filled rectangles, filled circles and Paint_ClearWindows() write
+*    whole bytes per line
+* 9.add: Paint_ImageFill() / Copy() / Invert() / Or() / And() (agent)
+*    Operations on a complete image, Paint_Clear() and Paint_DrawBitMap()
+*    use them
+* 10.add: Paint_DrawRowBits() (agent)
+*    Draw a row of pixels given as bits, a byte at a time where possible
+* 11.Change: Paint_DrawString_CN() (agent)
+*    Finds characters with a lookup table on the cFONT instead of a scan
+* 12.Change: Paint_DrawString_CN() (agent)
+*    A cFONT can have codes and packed bitmaps instead of a table (.epf file)
+* 13.add: Paint_DrawGlyph() (agent)
+*    Glyph cache with the glyphs turned for the rotate and mirror
 *
 * Permission is hereby granted, free of charge, to any person obtaining a copy
 * of this software and associated documnetation files (the "Software"), to deal
@@ -52,7 +71,179 @@
 #include <string.h> //memset()
 #include <math.h>
 
-volatile PAINT Paint;
+PAINT Paint;
+
+/* changed area of the images in memory coordinates (inclusive) */
+static UWORD Dirty_Xstart, Dirty_Ystart, Dirty_Xend, Dirty_Yend;
+static UBYTE Dirty = 0;
+
+/******************************************************************************
+function:   Add an area to the changed (dirty) area
+parameter:
+    Xstart :   x starting point in memory
+    Ystart :   Y starting point in memory
+    Xend   :   x end point in memory (inclusive)
+    Yend   :   y end point in memory (inclusive)
+******************************************************************************/
+static inline void Paint_MarkDirty(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend)
+{
+    if (! Dirty) {
+        Dirty_Xstart = Xstart;
+        Dirty_Ystart = Ystart;
+        Dirty_Xend = Xend;
+        Dirty_Yend = Yend;
+        Dirty = 1;
+        return;
+    }
+
+    if (Xstart < Dirty_Xstart) Dirty_Xstart = Xstart;
+    if (Ystart < Dirty_Ystart) Dirty_Ystart = Ystart;
+    if (Xend > Dirty_Xend) Dirty_Xend = Xend;
+    if (Yend > Dirty_Yend) Dirty_Yend = Yend;
+}
+
+/******************************************************************************
+function:   Get the area that changed since Paint_ClearDirty()
+parameter:
+    Xstart :   receives x starting point in memory
+    Ystart :   receives Y starting point in memory
+    Xend   :   receives x end point in memory (inclusive)
+    Yend   :   receives y end point in memory (inclusive)
+Info:
+    One area is kept for all images, the coordinates are in memory
+    (after rotate and mirror) so they can be used by the display driver.
+    return 0 = nothing changed, 1 = area is returned
+******************************************************************************/
+UBYTE Paint_GetDirty(UWORD *Xstart, UWORD *Ystart, UWORD *Xend, UWORD *Yend)
+{
+    if (! Dirty) return 0;
+
+    *Xstart = Dirty_Xstart;
+    *Ystart = Dirty_Ystart;
+    *Xend = Dirty_Xend;
+    *Yend = Dirty_Yend;
+    return 1;
+}
+
+/******************************************************************************
+function:   Forget the changed area (e.g. after the images have been displayed)
+parameter:
+******************************************************************************/
+void Paint_ClearDirty(void)
+{
+    Dirty = 0;
+}
+
+/******************************************************************************
+function:   Pixel writers, one for every rotate and mirror
+parameter:
+    Xpoint  :   At point X
+    Ypoint  :   At point Y
+    Color   :   Painted colors
+Info:
+    The rotate and mirror are resolved at compile time, see
+    Paint_SelectWriter(). Paint_Clip_Width and Paint_Clip_Height are set
+    such that the point is inside the image memory once it is inside
+    the clip area.
+******************************************************************************/
+static UWORD Paint_Clip_Width, Paint_Clip_Height;
+
+/* a line of the image runs left to right in memory (rotate 0 or 180) */
+static UBYTE Paint_Line_Forward = 1;
+
+#define PAINT_WRITER(__name, __X, __Y, __mirror_x, __mirror_y)                  \
+static void __name(UWORD Xpoint, UWORD Ypoint, UWORD Color)                     \
+{                                                                               \
+    UWORD X, Y;                                                                 \
+    UDOUBLE Addr;                                                               \
+                                                                                \
+    if (Xpoint >= Paint_Clip_Width || Ypoint >= Paint_Clip_Height) {            \
+        Debug("Exceeding display boundaries\r\n");                              \
+        return;                                                                 \
+    }                                                                           \
+                                                                                \
+    X = (__X);                                                                  \
+    Y = (__Y);                                                                  \
+    if (__mirror_x) X = Paint.WidthMemory - X - 1;                              \
+    if (__mirror_y) Y = Paint.HeightMemory - Y - 1;                             \
+                                                                                \
+    Paint_MarkDirty(X, Y, X, Y);                                                \
+                                                                                \
+    Addr = X / 8 + Y * Paint.WidthByte;                                         \
+    if (Color == BLACK)                                                         \
+        Paint.Image[Addr] &= ~(0x80 >> (X % 8));                                \
+    else                                                                        \
+        Paint.Image[Addr] |= 0x80 >> (X % 8);                                   \
+}
+
+// rotate expressions
+#define R0_X    Xpoint
+#define R0_Y    Ypoint
+#define R90_X   Paint.WidthMemory - Ypoint - 1
+#define R90_Y   Xpoint
+#define R180_X  Paint.WidthMemory - Xpoint - 1
+#define R180_Y  Paint.HeightMemory - Ypoint - 1
+#define R270_X  Ypoint
+#define R270_Y  Paint.HeightMemory - Xpoint - 1
+
+PAINT_WRITER(Paint_Writer_0_N,   R0_X,   R0_Y,   0, 0)
+PAINT_WRITER(Paint_Writer_0_H,   R0_X,   R0_Y,   1, 0)
+PAINT_WRITER(Paint_Writer_0_V,   R0_X,   R0_Y,   0, 1)
+PAINT_WRITER(Paint_Writer_0_O,   R0_X,   R0_Y,   1, 1)
+PAINT_WRITER(Paint_Writer_90_N,  R90_X,  R90_Y,  0, 0)
+PAINT_WRITER(Paint_Writer_90_H,  R90_X,  R90_Y,  1, 0)
+PAINT_WRITER(Paint_Writer_90_V,  R90_X,  R90_Y,  0, 1)
+PAINT_WRITER(Paint_Writer_90_O,  R90_X,  R90_Y,  1, 1)
+PAINT_WRITER(Paint_Writer_180_N, R180_X, R180_Y, 0, 0)
+PAINT_WRITER(Paint_Writer_180_H, R180_X, R180_Y, 1, 0)
+PAINT_WRITER(Paint_Writer_180_V, R180_X, R180_Y, 0, 1)
+PAINT_WRITER(Paint_Writer_180_O, R180_X, R180_Y, 1, 1)
+PAINT_WRITER(Paint_Writer_270_N, R270_X, R270_Y, 0, 0)
+PAINT_WRITER(Paint_Writer_270_H, R270_X, R270_Y, 1, 0)
+PAINT_WRITER(Paint_Writer_270_V, R270_X, R270_Y, 0, 1)
+PAINT_WRITER(Paint_Writer_270_O, R270_X, R270_Y, 1, 1)
+
+// [rotate / 90][mirror]
+static const PAINT_PIXEL_WRITER Paint_Writers[4][4] = {
+    {Paint_Writer_0_N,   Paint_Writer_0_H,   Paint_Writer_0_V,   Paint_Writer_0_O},
+    {Paint_Writer_90_N,  Paint_Writer_90_H,  Paint_Writer_90_V,  Paint_Writer_90_O},
+    {Paint_Writer_180_N, Paint_Writer_180_H, Paint_Writer_180_V, Paint_Writer_180_O},
+    {Paint_Writer_270_N, Paint_Writer_270_H, Paint_Writer_270_V, Paint_Writer_270_O},
+};
+
+PAINT_PIXEL_WRITER Paint_PixelWriter = Paint_Writer_0_N;
+
+/******************************************************************************
+function:   Select the pixel writer for the current rotate and mirror
+parameter:
+Info:
+    The point must be inside the image (Width / Height) and, after rotate,
+    inside the image memory (WidthMemory / HeightMemory)
+******************************************************************************/
+static void Paint_SelectWriter(void)
+{
+    UWORD Max_Width, Max_Height;
+
+    if (Paint.Rotate == ROTATE_0 || Paint.Rotate == ROTATE_180) {
+        Max_Width = Paint.WidthMemory;
+        Max_Height = Paint.HeightMemory;
+    } else {
+        Max_Width = Paint.HeightMemory;
+        Max_Height = Paint.WidthMemory;
+    }
+
+    Paint_Clip_Width = Paint.Width < Max_Width ? Paint.Width : Max_Width;
+    Paint_Clip_Height = Paint.Height < Max_Height ? Paint.Height : Max_Height;
+
+    Paint_PixelWriter = Paint_Writers[Paint.Rotate / 90][Paint.Mirror & 0x03];
+
+    if (Paint.Rotate == ROTATE_0)
+        Paint_Line_Forward = ! (Paint.Mirror & MIRROR_HORIZONTAL);
+    else if (Paint.Rotate == ROTATE_180)
+        Paint_Line_Forward = (Paint.Mirror & MIRROR_HORIZONTAL) != 0;
+    else
+        Paint_Line_Forward = 0;
+}
 
 /******************************************************************************
 function:   Create Image
@@ -83,6 +274,8 @@ void Paint_NewImage(UBYTE *image, UWORD Width, UWORD Height, UWORD Rotate, UWORD
         Paint.Width = Height;
         Paint.Height = Width;
     }
+
+    Paint_SelectWriter();
 }
 
 /******************************************************************************
@@ -105,6 +298,7 @@ void Paint_SetRotate(UWORD Rotate)
     if(Rotate == ROTATE_0 || Rotate == ROTATE_90 || Rotate == ROTATE_180 || Rotate == ROTATE_270) {
         Debug("Set image Rotate %d\r\n", Rotate);
         Paint.Rotate = Rotate;
+        Paint_SelectWriter();
     } else {
         Debug("rotate = 0, 90, 180, 270\r\n");
         exit(0);
@@ -122,6 +316,7 @@ void Paint_SetMirroring(UBYTE mirror)
         mirror == MIRROR_VERTICAL || mirror == MIRROR_ORIGIN) {
         Debug("mirror image x:%s, y:%s\r\n",(mirror & 0x01)? "mirror":"none", ((mirror >> 1) & 0x01)? "mirror":"none");
         Paint.Mirror = mirror;
+        Paint_SelectWriter();
     } else {
         Debug("mirror should be MIRROR_NONE, MIRROR_HORIZONTAL, \
         MIRROR_VERTICAL or MIRROR_ORIGIN\r\n");
@@ -135,101 +330,471 @@ parameter:
     Xpoint  :   At point X
     Ypoint  :   At point Y
     Color   :   Painted colors
+Info:
+    calls the pixel writer for the current rotate and mirror
 ******************************************************************************/
 void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color)
 {
-    if(Xpoint > Paint.Width || Ypoint > Paint.Height){
-        Debug("Exceeding display boundaries\r\n");
-        return;
-    }      
-    UWORD X, Y;
+    Paint_PixelWriter(Xpoint, Ypoint, Color);
+}
 
+/******************************************************************************
+function:   Convert a point to memory coordinates
+parameter:
+    Xpoint  :   At point X
+    Ypoint  :   At point Y
+    X       :   receives X in memory
+    Y       :   receives Y in memory
+Info:
+    Same as the pixel writers, for the few places that need the memory
+    position themselves
+******************************************************************************/
+static void Paint_ToMemory(UWORD Xpoint, UWORD Ypoint, UWORD *X, UWORD *Y)
+{
     switch(Paint.Rotate) {
-// #if (MIRROR_IMAGE_DFT && MIRROR_NONE)
-    case 0:
-        X = Xpoint;
-        Y = Ypoint;  
-        break;
-    case 90:
-        X = Paint.WidthMemory - Ypoint - 1;
-        Y = Xpoint;
+    case ROTATE_90:
+        *X = Paint.WidthMemory - Ypoint - 1;
+        *Y = Xpoint;
         break;
-    case 180:
-        X = Paint.WidthMemory - Xpoint - 1;
-        Y = Paint.HeightMemory - Ypoint - 1;
+    case ROTATE_180:
+        *X = Paint.WidthMemory - Xpoint - 1;
+        *Y = Paint.HeightMemory - Ypoint - 1;
         break;
-    case 270:
-        X = Ypoint;
-        Y = Paint.HeightMemory - Xpoint - 1;
+    case ROTATE_270:
+        *X = Ypoint;
+        *Y = Paint.HeightMemory - Xpoint - 1;
         break;
-// #elif (MIRROR_IMAGE_DFT && MIRROR_HORIZONTAL)
-    // case 0:
-        // X = Paint.WidthMemory - Xpoint - 1;
-        // Y = Ypoint;        
-        // break;
-    // case 90:
-        // X = Ypoint;
-        // Y = Xpoint;
-        // break;
-    // case 180:
-        // X = Xpoint;
-        // Y = Paint.HeightMemory - Ypoint - 1;
-        // break;
-    // case 270:
-        // X = Paint.WidthMemory - Ypoint - 1;
-        // Y = Paint.HeightMemory - Xpoint - 1;
-        // break;
-// #elif (MIRROR_IMAGE_DFT && MIRROR_VERTICAL)
-    // case 0:
-        // X = Xpoint;
-        // Y = Paint.HeightMemory - Ypoint;      
-        // break;
-    // case 90:
-        // X = Paint.WidthMemory - Ypoint - 1;
-        // Y = Paint.HeightMemory - Xpoint;
-        // break;
-    // case 180:
-        // X = Paint.WidthMemory - Xpoint - 1;
-        // Y = Ypoint;
-        // break;
-    // case 270:
-        // X = Ypoint;
-        // Y = Xpoint;
-        // break;
-// #endif
     default:
-        return;
-    }
-    
-    switch(Paint.Mirror) {
-    case MIRROR_NONE:
-        break;
-    case MIRROR_HORIZONTAL:
-        X = Paint.WidthMemory - X - 1;
-        break;
-    case MIRROR_VERTICAL:
-        Y = Paint.HeightMemory - Y - 1;
+        *X = Xpoint;
+        *Y = Ypoint;
         break;
-    case MIRROR_ORIGIN:
-        X = Paint.WidthMemory - X - 1;
-        Y = Paint.HeightMemory - Y - 1;
-        break;
-    default:
+    }
+
+    if (Paint.Mirror & MIRROR_HORIZONTAL) *X = Paint.WidthMemory - *X - 1;
+    if (Paint.Mirror & MIRROR_VERTICAL) *Y = Paint.HeightMemory - *Y - 1;
+}
+
+/******************************************************************************
+function:   Fill a horizontal line in memory
+parameter:
+    Xstart :   x starting point in memory
+    Xend   :   x end point in memory (inclusive)
+    Y      :   line in memory
+    Color  :   Painted colors
+Info:
+    The first and last byte are masked, the bytes in between are set at once
+******************************************************************************/
+static void Paint_FillMemorySpan(UWORD Xstart, UWORD Xend, UWORD Y, UWORD Color)
+{
+    UBYTE *Line = Paint.Image + (UDOUBLE) Y * Paint.WidthByte;
+    UWORD Byte_Start = Xstart / 8, Byte_End = Xend / 8;
+    UBYTE Mask_Start = 0xFF >> (Xstart % 8);
+    UBYTE Mask_End = 0xFF << (7 - Xend % 8);
+    UBYTE Fill = (Color == BLACK) ? 0x00 : 0xFF;
+
+    if (Byte_Start == Byte_End) {
+        Mask_Start &= Mask_End;
+        Line[Byte_Start] = (Line[Byte_Start] & ~Mask_Start) | (Fill & Mask_Start);
         return;
     }
 
-    // printf("x = %d, y = %d\r\n", X, Y);
-    if(X > Paint.WidthMemory || Y > Paint.HeightMemory){
-        Debug("Exceeding display memory boundaries\r\n");
+    Line[Byte_Start] = (Line[Byte_Start] & ~Mask_Start) | (Fill & Mask_Start);
+    memset(Line + Byte_Start + 1, Fill, Byte_End - Byte_Start - 1);
+    Line[Byte_End] = (Line[Byte_End] & ~Mask_End) | (Fill & Mask_End);
+}
+
+/******************************************************************************
+function:   Fill an area
+parameter:
+    Xstart :   x starting point
+    Ystart :   Y starting point
+    Xend   :   x end point (inclusive)
+    Yend   :   y end point (inclusive)
+    Color  :   Painted colors
+Info:
+    The area is clipped like the pixel writers do (negative is allowed),
+    turned to memory coordinates and filled line by line in memory.
+******************************************************************************/
+static void Paint_FillArea(int Xstart, int Ystart, int Xend, int Yend, UWORD Color)
+{
+    UWORD X0, Y0, X1, Y1, Y;
+
+    if (Xstart < 0) Xstart = 0;
+    if (Ystart < 0) Ystart = 0;
+    if (Xend >= Paint_Clip_Width) Xend = Paint_Clip_Width - 1;
+    if (Yend >= Paint_Clip_Height) Yend = Paint_Clip_Height - 1;
+    if (Xstart > Xend || Ystart > Yend) return;
+
+    Paint_ToMemory(Xstart, Ystart, &X0, &Y0);
+    Paint_ToMemory(Xend, Yend, &X1, &Y1);
+
+    if (X0 > X1) { UWORD t = X0; X0 = X1; X1 = t; }
+    if (Y0 > Y1) { UWORD t = Y0; Y0 = Y1; Y1 = t; }
+
+    Paint_MarkDirty(X0, Y0, X1, Y1);
+
+    for (Y = Y0; Y <= Y1; Y++)
+        Paint_FillMemorySpan(X0, X1, Y, Color);
+}
+
+/******************************************************************************
+function:   Draw a horizontal line of pixels
+parameter:
+    Xstart :   x starting point
+    Xend   :   x end point (inclusive)
+    Ypoint :   At point Y
+    Color  :   Painted colors
+Info:
+    Writes whole bytes if the line is horizontal in memory (rotate 0 or 180)
+******************************************************************************/
+void Paint_DrawSpan(UWORD Xstart, UWORD Xend, UWORD Ypoint, UWORD Color)
+{
+    if (Xstart > Xend) { UWORD t = Xstart; Xstart = Xend; Xend = t; }
+
+    Paint_FillArea(Xstart, Ypoint, Xend, Ypoint, Color);
+}
+
+/******************************************************************************
+function:   Write a row of up to 64 pixels given as bits in memory
+parameter:
+    Image   :   image to write in
+    X       :   X in memory of the first pixel
+    Y       :   Y in memory
+    Bits    :   a 1 for every pixel to write, first pixel in bit 63 (not 0)
+    Color   :   Painted colors
+Info:
+    The row must fit in the image memory, the caller marks the dirty area
+******************************************************************************/
+static void Paint_WriteMemoryBits(UBYTE *Image, UWORD X, UWORD Y, uint64_t Bits, UWORD Color)
+{
+    UBYTE Mask, *Line = Image + (UDOUBLE) Y * Paint.WidthByte + X / 8;
+
+    // first byte holds 8 - X % 8 pixels, then 8 for every byte
+    Mask = (UBYTE) (Bits >> (56 + X % 8));
+    Bits <<= 8 - X % 8;
+
+    while (1) {
+        if (Color == BLACK) *Line &= ~Mask;
+        else *Line |= Mask;
+
+        if (Bits == 0) break;
+
+        Mask = (UBYTE) (Bits >> 56);
+        Bits <<= 8;
+        Line++;
+    }
+}
+
+/******************************************************************************
+function:   Draw a row of up to 64 pixels given as bits
+parameter:
+    Image   :   image to draw in (does not change the selected image)
+    Xpoint  :   X of the first pixel
+    Ypoint  :   At point Y
+    Bits    :   a 1 for every pixel to draw, first pixel in bit 63
+    Width   :   number of pixels in Bits (max 64)
+    Color   :   Painted colors
+Info:
+    If the line runs left to right in memory the bits are shifted in place
+    and written a byte at a time. Else (rotate 90 / 270, mirrored) it is
+    done pixel by pixel.
+******************************************************************************/
+void Paint_DrawRowBits(UBYTE *Image, UWORD Xpoint, UWORD Ypoint, uint64_t Bits, UWORD Width, UWORD Color)
+{
+    UWORD X, Y, i;
+    UBYTE *Selected;
+
+    if (Xpoint >= Paint_Clip_Width || Ypoint >= Paint_Clip_Height) return;
+
+    if (Width > Paint_Clip_Width - Xpoint) Width = Paint_Clip_Width - Xpoint;
+    if (Width < 64) Bits &= ~(~(uint64_t) 0 >> Width);
+    else Width = 64;
+
+    if (Bits == 0) return;
+
+    if (! Paint_Line_Forward) {
+        Selected = Paint.Image;
+        Paint.Image = Image;
+
+        for (i = 0; i < Width; i++) {
+            if (Bits & ((uint64_t) 1 << (63 - i)))
+                Paint_PixelWriter(Xpoint + i, Ypoint, Color);
+        }
+
+        Paint.Image = Selected;
         return;
     }
-    
-    UDOUBLE Addr = X / 8 + Y * Paint.WidthByte;
-    UBYTE Rdata = Paint.Image[Addr];
-    if(Color == BLACK)
-        Paint.Image[Addr] = Rdata & ~(0x80 >> (X % 8));
-    else
-        Paint.Image[Addr] = Rdata | (0x80 >> (X % 8));
+
+    Paint_ToMemory(Xpoint, Ypoint, &X, &Y);
+    Paint_MarkDirty(X, Y, X + Width - 1, Y);
+
+    Paint_WriteMemoryBits(Image, X, Y, Bits, Color);
+}
+
+/******************************************************************************
+function:   Glyph cache
+Info:
+    A glyph drawn while the line does not run left to right in memory
+    (rotate 90 / 270, mirrored) is turned into memory rows once, after that
+    it is written a byte at a time like an unrotated glyph.
+    Direct mapped on the glyph bitmap (font and character), rotate and
+    mirror. A glyph that maps on a used entry replaces it.
+******************************************************************************/
+#define PAINT_GLYPH_MAX     64      // maximum width and height of a cached glyph
+#define PAINT_GLYPH_CACHE   256     // number of entries, power of 2
+
+typedef struct {
+    const unsigned char *Glyph;     // NULL = empty
+    UWORD Width;
+    UWORD Height;
+    UWORD Rotate;
+    UWORD Mirror;
+    UWORD Mem_Width;                // size in memory
+    UWORD Mem_Height;
+    uint64_t Row[PAINT_GLYPH_MAX];  // memory rows, first pixel in bit 63
+} PAINT_GLYPH;
+
+static PAINT_GLYPH *Paint_Glyphs = NULL;
+static UDOUBLE Paint_Glyph_Hits = 0, Paint_Glyph_Misses = 0;
+
+/******************************************************************************
+function:   Turn a glyph into memory rows for the current rotate and mirror
+parameter:
+    Entry   :   cache entry to fill
+    Glyph   :   bitmap, Height rows of (Width + 7) / 8 bytes, MSB first
+    Width   :   width of the glyph
+    Height  :   height of the glyph
+******************************************************************************/
+static void Paint_BuildGlyph(PAINT_GLYPH *Entry, const unsigned char *Glyph, UWORD Width, UWORD Height)
+{
+    UWORD Width_Byte = Width / 8 + (Width % 8 ? 1 : 0);
+    UWORD X0, Y0, X1, Y1, X, Y, Page, Column;
+
+    Paint_ToMemory(0, 0, &X0, &Y0);
+    Paint_ToMemory(Width - 1, Height - 1, &X1, &Y1);
+    if (X0 > X1) { X = X0; X0 = X1; X1 = X; }
+    if (Y0 > Y1) { Y = Y0; Y0 = Y1; Y1 = Y; }
+
+    Entry->Glyph = Glyph;
+    Entry->Width = Width;
+    Entry->Height = Height;
+    Entry->Rotate = Paint.Rotate;
+    Entry->Mirror = Paint.Mirror;
+    Entry->Mem_Width = X1 - X0 + 1;
+    Entry->Mem_Height = Y1 - Y0 + 1;
+    memset(Entry->Row, 0x0, sizeof(Entry->Row));
+
+    for (Page = 0; Page < Height; Page++) {
+        for (Column = 0; Column < Width; Column++) {
+            if (Glyph[Page * Width_Byte + Column / 8] & (0x80 >> (Column % 8))) {
+                Paint_ToMemory(Column, Page, &X, &Y);
+                Entry->Row[Y - Y0] |= (uint64_t) 1 << (63 - (X - X0));
+            }
+        }
+    }
+}
+
+/******************************************************************************
+function:   Draw a glyph through the glyph cache
+parameter:
+    Xpoint           : X of the glyph
+    Ypoint           : Y of the glyph
+    Glyph            : bitmap, Height rows of (Width + 7) / 8 bytes, MSB first
+    Width            : width of the glyph
+    Height           : height of the glyph
+    Image_Foreground : image for the set bits, NULL = not drawn
+    Color_Foreground : color of the set bits
+    Image_Background : image for the clear bits, NULL = not drawn
+    Color_Background : color of the clear bits
+Info:
+    The glyph bitmap must stay at the same address as long as it is used
+    (compiled-in font or mapped font file).
+    return 0 = drawn, 1 = not drawn: draw the rows with Paint_DrawRowBits()
+    (line runs left to right in memory, glyph too large or not completely
+    on the image)
+******************************************************************************/
+UBYTE Paint_DrawGlyph(UWORD Xpoint, UWORD Ypoint, const unsigned char *Glyph, UWORD Width, UWORD Height,
+                      UBYTE *Image_Foreground, UWORD Color_Foreground,
+                      UBYTE *Image_Background, UWORD Color_Background)
+{
+    PAINT_GLYPH *Entry;
+    UWORD X0, Y0, X1, Y1, i;
+    uint64_t Fill;
+    uintptr_t Key;
+
+    if (Paint_Line_Forward || Width > PAINT_GLYPH_MAX || Height > PAINT_GLYPH_MAX ||
+        Xpoint + Width > Paint_Clip_Width || Ypoint + Height > Paint_Clip_Height)
+        return 1;
+
+    if (Paint_Glyphs == NULL) {
+        if ((Paint_Glyphs = (PAINT_GLYPH *) calloc(PAINT_GLYPH_CACHE, sizeof(PAINT_GLYPH))) == NULL)
+            return 1;
+    }
+
+    Key = (uintptr_t) Glyph ^ ((uintptr_t) Glyph >> 9) ^ (Paint.Rotate / 90) ^ (Paint.Mirror << 2);
+    Entry = &Paint_Glyphs[Key & (PAINT_GLYPH_CACHE - 1)];
+
+    if (Entry->Glyph == Glyph && Entry->Rotate == Paint.Rotate && Entry->Mirror == Paint.Mirror &&
+        Entry->Width == Width && Entry->Height == Height)
+        Paint_Glyph_Hits++;
+    else {
+        Paint_Glyph_Misses++;
+        Paint_BuildGlyph(Entry, Glyph, Width, Height);
+    }
+
+    Paint_ToMemory(Xpoint, Ypoint, &X0, &Y0);
+    Paint_ToMemory(Xpoint + Width - 1, Ypoint + Height - 1, &X1, &Y1);
+    if (X0 > X1) X0 = X1;
+    if (Y0 > Y1) Y0 = Y1;
+
+    Paint_MarkDirty(X0, Y0, X0 + Entry->Mem_Width - 1, Y0 + Entry->Mem_Height - 1);
+
+    Fill = (Entry->Mem_Width < 64) ? ~(~(uint64_t) 0 >> Entry->Mem_Width) : ~(uint64_t) 0;
+
+    for (i = 0; i < Entry->Mem_Height; i++) {
+        if (Image_Foreground != NULL && Entry->Row[i] != 0)
+            Paint_WriteMemoryBits(Image_Foreground, X0, Y0 + i, Entry->Row[i], Color_Foreground);
+
+        if (Image_Background != NULL && (~Entry->Row[i] & Fill) != 0)
+            Paint_WriteMemoryBits(Image_Background, X0, Y0 + i, ~Entry->Row[i] & Fill, Color_Background);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+function:   Glyph cache statistics
+parameter:
+    Hits    :   number of glyphs found in the cache
+    Misses  :   number of glyphs added to the cache
+******************************************************************************/
+void Paint_GlyphStats(UDOUBLE *Hits, UDOUBLE *Misses)
+{
+    *Hits = Paint_Glyph_Hits;
+    *Misses = Paint_Glyph_Misses;
+}
+
+/******************************************************************************
+function:   Size of an image in bytes
+parameter:
+******************************************************************************/
+static UDOUBLE Paint_ImageSize(void)
+{
+    return (UDOUBLE) Paint.WidthByte * Paint.HeightByte;
+}
+
+/**
+ * operations of Paint_ImageOp()
+**/
+#define IMAGE_OP_INVERT     0
+#define IMAGE_OP_OR         1
+#define IMAGE_OP_AND        2
+
+typedef uint64_t IMAGE_WORD;
+
+/******************************************************************************
+function:   Invert an image or combine it with another image
+parameter:
+    Image   :   image to change
+    Src     :   image to combine with (not used for IMAGE_OP_INVERT)
+    Op      :   IMAGE_OP_xxx
+Info:
+    Works on a word at a time if both images are word aligned, which they
+    are when allocated with malloc(). The rest is done per byte.
+******************************************************************************/
+static void Paint_ImageOp(UBYTE *Image, const UBYTE *Src, UBYTE Op)
+{
+    UDOUBLE i = 0, Len = Paint_ImageSize();
+    IMAGE_WORD *Image_W = (IMAGE_WORD *) Image;
+    const IMAGE_WORD *Src_W = (const IMAGE_WORD *) Src;
+
+    if (Op == IMAGE_OP_INVERT) Src = Image;
+
+    if (((uintptr_t) Image | (uintptr_t) Src) % sizeof(IMAGE_WORD) == 0) {
+        switch (Op) {
+        case IMAGE_OP_INVERT:
+            for (; i + sizeof(IMAGE_WORD) <= Len; i += sizeof(IMAGE_WORD), Image_W++)
+                *Image_W = ~*Image_W;
+            break;
+        case IMAGE_OP_OR:
+            for (; i + sizeof(IMAGE_WORD) <= Len; i += sizeof(IMAGE_WORD))
+                *Image_W++ |= *Src_W++;
+            break;
+        case IMAGE_OP_AND:
+            for (; i + sizeof(IMAGE_WORD) <= Len; i += sizeof(IMAGE_WORD))
+                *Image_W++ &= *Src_W++;
+            break;
+        }
+    }
+
+    for (; i < Len; i++) {
+        switch (Op) {
+        case IMAGE_OP_INVERT:
+            Image[i] = ~Image[i];
+            break;
+        case IMAGE_OP_OR:
+            Image[i] |= Src[i];
+            break;
+        case IMAGE_OP_AND:
+            Image[i] &= Src[i];
+            break;
+        }
+    }
+
+    Paint_MarkDirty(0, 0, Paint.WidthMemory - 1, Paint.HeightMemory - 1);
+}
+
+/******************************************************************************
+function:   Fill a complete image
+parameter:
+    Image   :   Pointer to the image cache
+    Value   :   byte to fill with (WHITE or BLACK)
+******************************************************************************/
+void Paint_ImageFill(UBYTE *Image, UBYTE Value)
+{
+    memset(Image, Value, Paint_ImageSize());
+    Paint_MarkDirty(0, 0, Paint.WidthMemory - 1, Paint.HeightMemory - 1);
+}
+
+/******************************************************************************
+function:   Copy a complete image
+parameter:
+    Image   :   Pointer to the image cache
+    Src     :   image to copy
+******************************************************************************/
+void Paint_ImageCopy(UBYTE *Image, const UBYTE *Src)
+{
+    memcpy(Image, Src, Paint_ImageSize());
+    Paint_MarkDirty(0, 0, Paint.WidthMemory - 1, Paint.HeightMemory - 1);
+}
+
+/******************************************************************************
+function:   Invert every pixel of an image
+parameter:
+    Image   :   Pointer to the image cache
+******************************************************************************/
+void Paint_ImageInvert(UBYTE *Image)
+{
+    Paint_ImageOp(Image, NULL, IMAGE_OP_INVERT);
+}
+
+/******************************************************************************
+function:   Combine two images
+parameter:
+    Image   :   Pointer to the image cache, receives the result
+    Src     :   image to combine with
+Info:
+    With 0 = black (or red), AND keeps the pixels set in either image and
+    OR keeps only the pixels set in both images.
+******************************************************************************/
+void Paint_ImageOr(UBYTE *Image, const UBYTE *Src)
+{
+    Paint_ImageOp(Image, Src, IMAGE_OP_OR);
+}
+
+void Paint_ImageAnd(UBYTE *Image, const UBYTE *Src)
+{
+    Paint_ImageOp(Image, Src, IMAGE_OP_AND);
 }
 
 /******************************************************************************
@@ -239,13 +804,7 @@ parameter:
 ******************************************************************************/
 void Paint_Clear(UWORD Color)
 {
-    // Debug("x = %d, y = %d\r\n", Paint.WidthByte, Paint.Height);
-    for (UWORD Y = 0; Y < Paint.HeightByte; Y++) {
-        for (UWORD X = 0; X < Paint.WidthByte; X++ ) {//8 pixel =  1 byte
-            UDOUBLE Addr = X + Y*Paint.WidthByte;
-            Paint.Image[Addr] = Color;
-        }
-    }
+    Paint_ImageFill(Paint.Image, Color);
 }
 
 /******************************************************************************
@@ -258,12 +817,7 @@ parameter:
 ******************************************************************************/
 void Paint_ClearWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color)
 {
-    UWORD X, Y;
-    for (Y = Ystart; Y < Yend; Y++) {
-        for (X = Xstart; X < Xend; X++) {//8 pixel =  1 byte
-            Paint_SetPixel(X, Y, Color);
-        }
-    }
+    Paint_FillArea(Xstart, Ystart, Xend - 1, Yend - 1, Color);
 }
 
 /******************************************************************************
@@ -289,13 +843,13 @@ void Paint_DrawPoint(UWORD Xpoint, UWORD Ypoint, UWORD Color,
                 if(Xpoint + XDir_Num - Dot_Pixel < 0 || Ypoint + YDir_Num - Dot_Pixel < 0)
                     break;
                 // printf("x = %d, y = %d\r\n", Xpoint + XDir_Num - Dot_Pixel, Ypoint + YDir_Num - Dot_Pixel);
-                Paint_SetPixel(Xpoint + XDir_Num - Dot_Pixel, Ypoint + YDir_Num - Dot_Pixel, Color);
+                Paint_PixelWriter(Xpoint + XDir_Num - Dot_Pixel, Ypoint + YDir_Num - Dot_Pixel, Color);
             }
         }
     } else {
         for (XDir_Num = 0; XDir_Num <  Dot_Pixel; XDir_Num++) {
             for (YDir_Num = 0; YDir_Num <  Dot_Pixel; YDir_Num++) {
-                Paint_SetPixel(Xpoint + XDir_Num - 1, Ypoint + YDir_Num - 1, Color);
+                Paint_PixelWriter(Xpoint + XDir_Num - 1, Ypoint + YDir_Num - 1, Color);
             }
         }
     }
@@ -377,10 +931,16 @@ void Paint_DrawRectangle(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
     }
 
     if (Filled ) {
-        UWORD Ypoint;
-        for(Ypoint = Ystart; Ypoint < Yend; Ypoint++) {
-            Paint_DrawLine(Xstart, Ypoint, Xend, Ypoint, Color , LINE_STYLE_SOLID, Dot_Pixel);
-        }
+        // same area as a Paint_DrawLine() for every Y from Ystart to Yend - 1:
+        // Paint_DrawPoint() covers X - Dot_Pixel to X + Dot_Pixel - 2 and skips
+        // a point that starts above the image
+        int Xmin = Xstart < Xend ? Xstart : Xend;
+        int Xmax = Xstart < Xend ? Xend : Xstart;
+        int Yfirst = Ystart > Dot_Pixel ? Ystart : Dot_Pixel;
+
+        if (Yfirst < Yend)
+            Paint_FillArea(Xmin - Dot_Pixel, Yfirst - Dot_Pixel,
+                           Xmax + Dot_Pixel - 2, Yend - 1 + Dot_Pixel - 2, Color);
     } else {
         Paint_DrawLine(Xstart, Ystart, Xend, Ystart, Color , LINE_STYLE_SOLID, Dot_Pixel);
         Paint_DrawLine(Xstart, Ystart, Xstart, Yend, Color , LINE_STYLE_SOLID, Dot_Pixel);
@@ -389,6 +949,32 @@ void Paint_DrawRectangle(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend,
     }
 }
 
+/******************************************************************************
+function:   Fill two lines of a filled circle
+parameter:
+    X_Center  ：Center X coordinate
+    Y_Center  ：Center Y coordinate
+    Line      ：distance of the lines to the center
+    Half      ：half the length of the lines
+    Color     ：The color of the circle
+Info:
+    A circle is the same in both directions, the lines are taken horizontal
+    in memory so they can be written as whole bytes. The -1 offset is the
+    same as Paint_DrawPoint() with DOT_PIXEL_1X1.
+******************************************************************************/
+static void Paint_FillCircleLines(UWORD X_Center, UWORD Y_Center, int Line, int Half, UWORD Color)
+{
+    int X = X_Center - 1, Y = Y_Center - 1;
+
+    if (Paint.Rotate == ROTATE_0 || Paint.Rotate == ROTATE_180) {
+        Paint_FillArea(X - Half, Y + Line, X + Half, Y + Line, Color);
+        if (Line) Paint_FillArea(X - Half, Y - Line, X + Half, Y - Line, Color);
+    } else {
+        Paint_FillArea(X + Line, Y - Half, X + Line, Y + Half, Color);
+        if (Line) Paint_FillArea(X - Line, Y - Half, X - Line, Y + Half, Color);
+    }
+}
+
 /******************************************************************************
 function:   Use the 8-point method to draw a circle of the
             specified size at the specified position->
@@ -415,22 +1001,16 @@ void Paint_DrawCircle(UWORD X_Center, UWORD Y_Center, UWORD Radius,
     //Cumulative error,judge the next point of the logo
     int16_t Esp = 3 - (Radius << 1 );
 
-    int16_t sCountY;
     if (Draw_Fill == DRAW_FILL_FULL) {
         while (XCurrent <= YCurrent ) { //Realistic circles
-            for (sCountY = XCurrent; sCountY <= YCurrent; sCountY ++ ) {
-                Paint_DrawPoint(X_Center + XCurrent, Y_Center + sCountY, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//1
-                Paint_DrawPoint(X_Center - XCurrent, Y_Center + sCountY, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//2
-                Paint_DrawPoint(X_Center - sCountY, Y_Center + XCurrent, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//3
-                Paint_DrawPoint(X_Center - sCountY, Y_Center - XCurrent, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//4
-                Paint_DrawPoint(X_Center - XCurrent, Y_Center - sCountY, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//5
-                Paint_DrawPoint(X_Center + XCurrent, Y_Center - sCountY, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//6
-                Paint_DrawPoint(X_Center + sCountY, Y_Center - XCurrent, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);//7
-                Paint_DrawPoint(X_Center + sCountY, Y_Center + XCurrent, Color, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-            }
+            // lines +/- XCurrent
+            Paint_FillCircleLines(X_Center, Y_Center, XCurrent, YCurrent, Color);
+
             if (Esp < 0 )
                 Esp += 4 * XCurrent + 6;
             else {
+                // lines +/- YCurrent are complete
+                Paint_FillCircleLines(X_Center, Y_Center, YCurrent, XCurrent, Color);
                 Esp += 10 + 4 * (XCurrent - YCurrent );
                 YCurrent --;
             }
@@ -487,14 +1067,14 @@ void Paint_DrawChar(UWORD Xpoint, UWORD Ypoint, const char Acsii_Char,
             //To determine whether the font background color and screen background color is consistent
             if (FONT_BACKGROUND == Color_Background) { //this process is to speed up the scan
                 if (*ptr & (0x80 >> (Column % 8)))
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, Color_Foreground);
+                    Paint_PixelWriter(Xpoint + Column, Ypoint + Page, Color_Foreground);
                     // Paint_DrawPoint(Xpoint + Column, Ypoint + Page, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
             } else {
                 if (*ptr & (0x80 >> (Column % 8))) {
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, Color_Foreground);
+                    Paint_PixelWriter(Xpoint + Column, Ypoint + Page, Color_Foreground);
                     // Paint_DrawPoint(Xpoint + Column, Ypoint + Page, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
                 } else {
-                    Paint_SetPixel(Xpoint + Column, Ypoint + Page, Color_Background);
+                    Paint_PixelWriter(Xpoint + Column, Ypoint + Page, Color_Background);
                     // Paint_DrawPoint(Xpoint + Column, Ypoint + Page, Color_Background, DOT_PIXEL_DFT, DOT_STYLE_DFT);
                 }
             }
@@ -551,6 +1131,150 @@ void Paint_DrawString_EN(UWORD Xstart, UWORD Ystart, const char * pString,
 }
 
 
+/******************************************************************************
+function:   Lookup key of a character in a cFONT
+parameter:
+    First   :   first byte (ASCII or first byte of GB2312)
+    Second  :   second byte of GB2312 (not used for ASCII)
+******************************************************************************/
+#define CN_KEY(First, Second)   ((uint16_t) ((First) << 8 | ((First) <= 0x7F ? 0 : (Second))))
+#define CN_HASH(Key, Mask)      ((((uint32_t) (Key) * 2654435761U) >> 15) & (Mask))
+
+/******************************************************************************
+function:   Code and bitmap of character number Num in a cFONT
+parameter:
+    font    :   font with either a table (font file) or codes and bitmap
+    Num     :   number of the character in the font
+******************************************************************************/
+static inline uint16_t Paint_KeyCN(const cFONT *font, uint16_t Num)
+{
+    const unsigned char *Code = font->table ? font->table[Num].index : &font->codes[Num * 2];
+
+    return CN_KEY(Code[0], Code[1]);
+}
+
+static inline const unsigned char *Paint_GlyphCN(const cFONT *font, uint16_t Num)
+{
+    if (font->table) return (const unsigned char *) font->table[Num].matrix;
+
+    return &font->bitmap[(uint32_t) Num * font->Height * (font->Width / 8 + (font->Width % 8 ? 1 : 0))];
+}
+
+/******************************************************************************
+function:   Create the lookup table of a cFONT
+parameter:
+    font    :   font to create the lookup table for
+Info:
+    Open addressing with at least 2 slots per character. If a character is
+    in the font more than once the first one is used, like a linear scan.
+    return NULL if out of memory
+******************************************************************************/
+static CN_INDEX *Paint_IndexCN(cFONT *font)
+{
+    CN_INDEX *Index;
+    uint32_t Slots = 4, Slot;
+    uint16_t Num, Key;
+
+    if (font->lookup != NULL) return font->lookup;
+
+    while (Slots < (uint32_t) font->size * 2) Slots <<= 1;
+
+    if ((Index = (CN_INDEX *) malloc(sizeof(CN_INDEX))) == NULL)
+        return NULL;
+
+    if ((Index->slot = (uint16_t *) calloc(Slots, sizeof(uint16_t))) == NULL) {
+        free(Index);
+        return NULL;
+    }
+
+    Index->mask = Slots - 1;
+
+    for (Num = 0; Num < font->size; Num++) {
+        Key = Paint_KeyCN(font, Num);
+
+        for (Slot = CN_HASH(Key, Index->mask); Index->slot[Slot]; Slot = (Slot + 1) & Index->mask) {
+            if (Paint_KeyCN(font, Index->slot[Slot] - 1) == Key) break;
+        }
+
+        if (Index->slot[Slot] == 0) Index->slot[Slot] = Num + 1;
+    }
+
+    Debug("lookup table for %d characters, %d slots\r\n", font->size, Slots);
+
+    font->lookup = Index;
+    return Index;
+}
+
+/******************************************************************************
+function:   Find a character in a cFONT
+parameter:
+    font    :   font to search
+    First   :   first byte (ASCII or first byte of GB2312)
+    Second  :   second byte of GB2312 (not used for ASCII)
+Info:
+    return bitmap of the character, NULL if the character is not in the font
+******************************************************************************/
+static const unsigned char *Paint_FindCN(cFONT *font, UBYTE First, UBYTE Second)
+{
+    CN_INDEX *Index = Paint_IndexCN(font);
+    uint16_t Key = CN_KEY(First, Second), Num;
+    uint32_t Slot;
+
+    if (Index == NULL) {                    // no memory for the table: scan
+        for (Num = 0; Num < font->size; Num++) {
+            if (Paint_KeyCN(font, Num) == Key) return Paint_GlyphCN(font, Num);
+        }
+        return NULL;
+    }
+
+    for (Slot = CN_HASH(Key, Index->mask); (Num = Index->slot[Slot]) != 0; Slot = (Slot + 1) & Index->mask) {
+        if (Paint_KeyCN(font, Num - 1) == Key) return Paint_GlyphCN(font, Num - 1);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+function:   Show a character of a cFONT in the selected image
+parameter:
+    Xpoint           ：X coordinate
+    Ypoint           ：Y coordinate
+    Glyph            ：bitmap of the character to show
+    font             ：A structure pointer that displays a character size
+    Color_Background : background color, not drawn if FONT_BACKGROUND
+    Color_Foreground : foreground color
+******************************************************************************/
+static void Paint_DrawCharCN(UWORD Xpoint, UWORD Ypoint, const unsigned char *Glyph, cFONT* font,
+                             UWORD Color_Background, UWORD Color_Foreground)
+{
+    const unsigned char *ptr = Glyph;
+    UWORD Width_Byte = font->Width / 8 + (font->Width % 8 ? 1 : 0);
+    UWORD Page, Column, Width, i;
+    uint64_t Row, Fill;
+
+    if (Paint_DrawGlyph(Xpoint, Ypoint, Glyph, font->Width, font->Height, Paint.Image, Color_Foreground,
+                        FONT_BACKGROUND != Color_Background ? Paint.Image : NULL, Color_Background) == 0)
+        return;
+
+    for (Page = 0; Page < font->Height; Page++, ptr += Width_Byte) {
+        for (Column = 0; Column < font->Width; Column += 64) {
+            Width = font->Width - Column;
+            if (Width > 64) Width = 64;
+
+            Row = 0;
+            for (i = 0; i < (Width + 7) / 8; i++)
+                Row |= (uint64_t) ptr[Column / 8 + i] << (56 - 8 * i);
+
+            Fill = (Width < 64) ? ~(~(uint64_t) 0 >> Width) : ~(uint64_t) 0;
+
+            Paint_DrawRowBits(Paint.Image, Xpoint + Column, Ypoint + Page, Row & Fill, Width, Color_Foreground);
+
+            if (FONT_BACKGROUND != Color_Background) //this process is to speed up the scan
+                Paint_DrawRowBits(Paint.Image, Xpoint + Column, Ypoint + Page, ~Row & Fill, Width, Color_Background);
+        }
+    }
+}
+
 /******************************************************************************
 function:   Display the string
 parameter:
@@ -564,80 +1288,26 @@ parameter:
 ******************************************************************************/
 void Paint_DrawString_CN(UWORD Xstart, UWORD Ystart, const char * pString, cFONT* font, UWORD Color_Background, UWORD Color_Foreground)
 {
-    const char* p_text = pString;
+    const unsigned char* p_text = (const unsigned char *) pString;
+    const unsigned char *Glyph;
     int x = Xstart, y = Ystart;
-    int i, j,Num;
 
     /* Send the string character by character on EPD */
     while (*p_text != 0) {
         if(*p_text <= 0x7F) {  //ASCII < 126
-            for(Num = 0; Num < font->size; Num++) {
-                if(*p_text== font->table[Num].index[0]) {
-                    const char* ptr = &font->table[Num].matrix[0];
-
-                    for (j = 0; j < font->Height; j++) {
-                        for (i = 0; i < font->Width; i++) {
-                            if (FONT_BACKGROUND == Color_Background) { //this process is to speed up the scan
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            } else {
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                } else {
-                                    Paint_SetPixel(x + i, y + j, Color_Background);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Background, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            }
-                            if (i % 8 == 7) {
-                                ptr++;
-                            }
-                        }
-                        if (font->Width % 8 != 0) {
-                            ptr++;
-                        }
-                    }
-                    break;
-                }
-            }
+            if ((Glyph = Paint_FindCN(font, p_text[0], 0)) != NULL)
+                Paint_DrawCharCN(x, y, Glyph, font, Color_Background, Color_Foreground);
+
             /* Point on the next character */
             p_text += 1;
             /* Decrement the column position by 16 */
             x += font->ASCII_Width;
         } else {        //Chinese
-            for(Num = 0; Num < font->size; Num++) {
-                if((*p_text== font->table[Num].index[0]) && (*(p_text+1) == font->table[Num].index[1])) {
-                    const char* ptr = &font->table[Num].matrix[0];
-
-                    for (j = 0; j < font->Height; j++) {
-                        for (i = 0; i < font->Width; i++) {
-                            if (FONT_BACKGROUND == Color_Background) { //this process is to speed up the scan
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            } else {
-                                if (*ptr & (0x80 >> (i % 8))) {
-                                    Paint_SetPixel(x + i, y + j, Color_Foreground);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Foreground, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                } else {
-                                    Paint_SetPixel(x + i, y + j, Color_Background);
-                                    // Paint_DrawPoint(x + i, y + j, Color_Background, DOT_PIXEL_DFT, DOT_STYLE_DFT);
-                                }
-                            }
-                            if (i % 8 == 7) {
-                                ptr++;
-                            }
-                        }
-                        if (font->Width % 8 != 0) {
-                            ptr++;
-                        }
-                    }
-                    break;
-                }
-            }
+            if (p_text[1] == 0) break;          // incomplete character
+
+            if ((Glyph = Paint_FindCN(font, p_text[0], p_text[1])) != NULL)
+                Paint_DrawCharCN(x, y, Glyph, font, Color_Background, Color_Foreground);
+
             /* Point on the next character */
             p_text += 2;
             /* Decrement the column position by 16 */
@@ -725,13 +1395,5 @@ info:
 ******************************************************************************/
 void Paint_DrawBitMap(const unsigned char* image_buffer)
 {
-    UWORD x, y;
-    UDOUBLE Addr = 0;
-
-    for (y = 0; y < Paint.HeightByte; y++) {
-        for (x = 0; x < Paint.WidthByte; x++) {//8 pixel =  1 byte
-            Addr = x + y * Paint.WidthByte;
-            Paint.Image[Addr] = (unsigned char)image_buffer[Addr];
-        }
-    }
+    Paint_ImageCopy(Paint.Image, image_buffer);
 }
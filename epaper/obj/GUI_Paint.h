@@ -24,6 +24,25 @@
 *    Can Mirroring the picture, horizontal, vertical, origin
 * 5.add: Paint_DrawString_CN() 
 *    Can display Chinese(GB1312)    
+* 6.add: Paint_GetDirty() / Paint_ClearDirty() (agent)
+*    Area of the images changed since the last display
+* 7.add: Paint_PixelWriter (agent)
+*    Pixel writer for the current rotate and mirror, selected once in
+*    Paint_NewImage(), Paint_SetRotate() and Paint_SetMirroring()
+* 8.add: Paint_DrawSpan() (agent)
+*    Filled rectangles, filled circles and Paint_ClearWindows() write
+*    whole bytes per line
+* 9.add: Paint_ImageFill() / Copy() / Invert() / Or() / And() (agent)
+*    Operations on a complete image, Paint_Clear() and Paint_DrawBitMap()
+*    use them
+* 10.add: Paint_DrawRowBits() (agent)
+*    Draw a row of pixels given as bits, a byte at a time where possible
+* 11.Change: Paint_DrawString_CN() (agent)
+*    Finds characters with a lookup table on the cFONT instead of a scan
+* 12.Change: Paint_DrawString_CN() (agent)
+*    A cFONT can have codes and packed bitmaps instead of a table (.epf file)
+* 13.add: Paint_DrawGlyph() (agent)
+*    Glyph cache with the glyphs turned for the rotate and mirror
 *
 * Permission is hereby granted, free of charge, to any person obtaining a copy
 * of this software and associated documnetation files (the "Software"), to deal
@@ -65,7 +84,14 @@ typedef struct {
     UWORD WidthByte;
     UWORD HeightByte;
 } PAINT;
-extern volatile PAINT Paint;
+extern PAINT Paint;
+
+/**
+ * Pixel writer for the current rotate and mirror
+ * (same as Paint_SetPixel() without the extra call)
+**/
+typedef void (*PAINT_PIXEL_WRITER)(UWORD Xpoint, UWORD Ypoint, UWORD Color);
+extern PAINT_PIXEL_WRITER Paint_PixelWriter;
 
 /**
  * Display rotate
@@ -161,7 +187,24 @@ void Paint_SetPixel(UWORD Xpoint, UWORD Ypoint, UWORD Color);
 void Paint_Clear(UWORD Color);
 void Paint_ClearWindows(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color);
 
+//complete image
+void Paint_ImageFill(UBYTE *Image, UBYTE Value);
+void Paint_ImageCopy(UBYTE *Image, const UBYTE *Src);
+void Paint_ImageInvert(UBYTE *Image);
+void Paint_ImageOr(UBYTE *Image, const UBYTE *Src);
+void Paint_ImageAnd(UBYTE *Image, const UBYTE *Src);
+
+//changed area
+UBYTE Paint_GetDirty(UWORD *Xstart, UWORD *Ystart, UWORD *Xend, UWORD *Yend);
+void Paint_ClearDirty(void);
+
 //Drawing
+void Paint_DrawSpan(UWORD Xstart, UWORD Xend, UWORD Ypoint, UWORD Color);
+void Paint_DrawRowBits(UBYTE *Image, UWORD Xpoint, UWORD Ypoint, uint64_t Bits, UWORD Width, UWORD Color);
+UBYTE Paint_DrawGlyph(UWORD Xpoint, UWORD Ypoint, const unsigned char *Glyph, UWORD Width, UWORD Height,
+                      UBYTE *Image_Foreground, UWORD Color_Foreground,
+                      UBYTE *Image_Background, UWORD Color_Background);
+void Paint_GlyphStats(UDOUBLE *Hits, UDOUBLE *Misses);
 void Paint_DrawPoint(UWORD Xpoint, UWORD Ypoint, UWORD Color, DOT_PIXEL Dot_Pixel, DOT_STYLE Dot_FillWay);
 void Paint_DrawLine(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color, LINE_STYLE Line_Style, DOT_PIXEL Dot_Pixel);
 void Paint_DrawRectangle(UWORD Xstart, UWORD Ystart, UWORD Xend, UWORD Yend, UWORD Color, DRAW_FILL Filled , DOT_PIXEL Dot_Pixel);
@@ -0,0 +1,91 @@
+/**
+ * Framed messages on the named pipes, used by epaper and remotepr
+ *
+ * Copyright (c) October 2026, agent
+ *
+ * All rights reserved.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * By default the remote program sends text and epaper answers with
+ * <<MORE>>, <<START>>, <<OK>> etc. After the remote program sent
+ * <<FRAMED>> and epaper answered <<FRAMED>>, both sides sent framed
+ * messages: a header followed by the payload. A complete instruction
+ * is one message and epaper answers each message with one reply.
+ *
+ * header (PIPE_MSG_HEADER bytes, numbers little endian)
+ *  0   'E' 'P'     magic
+ *  2   type        PIPE_MSG_xxx
+ *  3   0           reserved
+ *  4   length      bytes of payload (2 bytes)
+ *  6   id          request id, returned in the reply (4 bytes)
+ *
+ * The payload of a reply is 1 byte, the result as signed number:
+ *  0 = OK, -1 = execution error, -2 = syntax error, -3 = too long
+ *  1 = queued (epaper -A), a second reply with the result follows when
+ *      the request has been performed
+ *  2 = coalesced (epaper -L), performed but the frame was replaced by the
+ *      frame of a later request before it was displayed
+ *********************************************************************
+*/
+#ifndef PIPE_MSG_H
+#define PIPE_MSG_H
+
+# include <stdint.h>
+
+#define PIPE_MSG_HEADER 10
+
+#define PIPE_MSG_INSTRUCTION 1          // <instructions>
+#define PIPE_MSG_TEMPLATE    2          // name<instructions>
+#define PIPE_MSG_RENDER      3          // name var=value;var=value
+#define PIPE_MSG_TEXT        4          // back to text messages
+#define PIPE_MSG_CLOSE       5          // close down epaper
+#define PIPE_MSG_REPLY       0x80       // result of a message
+
+#define PIPE_MSG_OVERRUN     -3         // payload too long
+#define PIPE_MSG_QUEUED      1          // accepted, result follows
+#define PIPE_MSG_COALESCED   2          // frame replaced by a later one
+
+/**
+ * @brief fill a message header
+ */
+static inline void pipe_msg_set(uint8_t *hdr, uint8_t type, uint16_t length, uint32_t id)
+{
+    hdr[0] = 'E';
+    hdr[1] = 'P';
+    hdr[2] = type;
+    hdr[3] = 0;
+    hdr[4] = length & 0xff;
+    hdr[5] = length >> 8;
+    hdr[6] = id & 0xff;
+    hdr[7] = (id >> 8) & 0xff;
+    hdr[8] = (id >> 16) & 0xff;
+    hdr[9] = id >> 24;
+}
+
+/**
+ * @brief read a message header
+ *
+ * @return
+ * 0 = OK
+ * -1 = not a message header
+ */
+static inline int pipe_msg_get(const uint8_t *hdr, uint8_t *type, uint16_t *length, uint32_t *id)
+{
+    if (hdr[0] != 'E' || hdr[1] != 'P') return(-1);
+
+    *type = hdr[2];
+    *length = hdr[4] | hdr[5] << 8;
+    *id = hdr[6] | hdr[7] << 8 | hdr[8] << 16 | (uint32_t) hdr[9] << 24;
+
+    return(0);
+}
+
+#endif // PIPE_MSG_H
@@ -5,7 +5,7 @@
  * that moves vertical. To be used incombination with epaper.
  * 
  * The default pipes used are EPD_to and EPD_from. They can be created with 
- * ./create_pipes.
+ * ./create_pipes. With -S the unix socket of epaper (-S) is used instead.
  * 
  * See document epaper.odt
  * 
@@ -40,18 +40,26 @@
 # include <stdbool.h>
 # include <getopt.h>
 # include <poll.h>
+# include <sys/socket.h> // unix socket
+# include <sys/un.h>
+# include "pipe_msg.h"
 
 // version info in usage() 
 #define VERSION "1.0 July 2019"
 
 #define MAXFILENAME 100         // maximum length file or pipename
+#define MAXINSTRUCTIONS 1000    // maximum length epaper instructions (epaper.h)
 
 /*hold pipe info */
 char name_pipe_r[MAXFILENAME] = "./EPD_from";   // can be overruled from command line
 char name_pipe_w[MAXFILENAME] = "./EPD_to";     // can be overruled from command line
+char name_socket[MAXFILENAME] = "";             // unix socket instead of the pipes
 int p_fd_r = -1;                // pipe handles
 int p_fd_w = -1;
 struct  pollfd fd;              // needed for polling
+bool Framed = false;            // framed messages (pipe_msg.h)
+bool Text_Only = false;         // do not ask for framed messages
+uint32_t Msg_Id = 0;            // id of the last framed message
 
 bool DEBUG = false;
 
@@ -64,7 +72,7 @@ void close_out(int ret)
     
     // close pipes (if opened)
     if (p_fd_r  > 0)  close(p_fd_r);
-    if (p_fd_w  > 0)  close(p_fd_w);
+    if (p_fd_w  > 0 && p_fd_w != p_fd_r)  close(p_fd_w);
 
     exit(ret);
 }
@@ -76,11 +84,42 @@ void  Handler(int signo)
     close_out(EXIT_SUCCESS);
 }
 
+/**
+ * @brief connect to the unix socket of the EPD server
+ */
+void connect_socket()
+{
+    struct sockaddr_un addr;
+    
+    memset(&addr, 0x0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, name_socket, sizeof(addr.sun_path) - 1);
+    
+    if ( (p_fd_r = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        connect(p_fd_r, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        printf("can not connect to socket %s\n", name_socket);
+        close_out(EXIT_FAILURE);
+    }
+    
+    // one handle to read and write
+    p_fd_w = p_fd_r;
+    
+    // initialize polling structure to check whether a new command was
+    fd.fd = p_fd_r;
+    fd.events = POLLIN;
+}
+
 /** 
  * @brief open pipes to read and write  
  */
 void connect_pipes()
 {
+    if (name_socket[0] != 0x0) {
+        connect_socket();
+        return;
+    }
+    
     // open input pipe from EPD (open O_RDWR to prevent blocking)
     if ( (p_fd_r = open(name_pipe_r,O_RDWR)) < 0)
     {
@@ -126,8 +165,10 @@ int sent_to_pipe(char *buf, int len)
  * 
  * @return :
  * 
+ * COALESCED 5 // performed, frame replaced by a later one (epaper -L)
+ * FRAMED 3 // framed messages accepted
  * START 2  // execution started
- * MORE  1  // more instruction needed, end not detected
+ * MORE  1  // more instruction needed, end not detected (or template)
  * OK :  0  // all good, done
  * 
  * ERROR ; Negative 
@@ -145,7 +186,7 @@ int read_EPD()
     {
         if (DEBUG) printf("Wait responds from EPD program\n");
 
-        n = read(p_fd_r, buf, sizeof(buf));
+        n = read(p_fd_r, buf, sizeof(buf) - 1);
         
         // Any input ?
         if (n > 0)
@@ -164,8 +205,8 @@ int read_EPD()
                 ret = 1;
             }
             
-            else if (strstr(buf,"<<START>>") != NULL) {
-                ret = 2;
+            else if (strstr(buf,"<<FRAMED>>") != NULL) {
+                ret = 3;
             }
             else if (strstr(buf,"<<ERROR-1>>") != NULL) {
                 ret = -1;
@@ -176,19 +217,27 @@ int read_EPD()
             else if (strstr(buf,"<<OVERRUN>>") != NULL) {
                 ret = -3;
             }
+            else if (strstr(buf,"<<COALESCED>>") != NULL) {
+                ret = 5;
+            }
+            // START last, the result can be in the same read
+            else if (strstr(buf,"<<START>>") != NULL) {
+                ret = 2;
+            }
             else
                 ret = -4;
                 
             return(ret);
         }
 
-        else if (n < 0)
+        // a socket is closed by the EPD server
+        else if (n < 0 || (n == 0 && name_socket[0] != 0x0))
         {
             if (DEBUG) printf("reset/closing pipe");
             
             // reinit... as pipe connection seems to have been lost
             close(p_fd_r);
-            close(p_fd_w);
+            if (p_fd_w != p_fd_r) close(p_fd_w);
             
             // reset filedescriptors
             p_fd_r = p_fd_w = -1;
@@ -275,6 +324,10 @@ int send_EPD(char *instruction, int length)
                 if (DEBUG) printf("Transfer complete, waiting execution\n");
                 break;
             
+            case 5:
+                if (DEBUG) printf("Performed, replaced by a later frame\n");
+                return(0);
+            
             case -1:
                 if (DEBUG) printf("Execution error\n");
                 return(-1);
@@ -298,6 +351,171 @@ int send_EPD(char *instruction, int length)
     }
 }
 
+/**
+ * @brief ask the EPD server for framed messages
+ * 
+ * An older EPD server does not know <<FRAMED>> and answers with an
+ * error, text messages are used then.
+ */
+void set_framed()
+{
+    char    buf[20];
+    int     ret;
+    
+    // remove any pending responds from pipe
+    if (poll(&fd,1,50) > 0)   read(p_fd_r, buf, sizeof(buf));
+    
+    if (sent_to_pipe("<<FRAMED>>", 10) != 0) return;
+    
+    // skip start of execution
+    while ((ret = read_EPD()) == 2);
+    
+    Framed = (ret == 3);
+    
+    if (DEBUG) printf("using %s messages\n", Framed ? "framed" : "text");
+}
+
+/**
+ * @brief sent a framed message to the EPD server and wait for the result
+ * 
+ * @param type : PIPE_MSG_xxx
+ * @param payload : text to sent
+ * 
+ * @return
+ * 0 succesfull
+ * -1 error
+ */
+int send_framed(uint8_t type, char *payload)
+{
+    uint8_t msg[PIPE_MSG_HEADER + MAXINSTRUCTIONS];
+    int     len = strlen(payload), i, n;
+    uint8_t r_type;
+    uint16_t r_len;
+    uint32_t r_id;
+    
+    if (len >= MAXINSTRUCTIONS) {
+        printf("message too long for EPD (%d)\n", len);
+        return(-1);
+    }
+    
+    // the whole message in one write
+    pipe_msg_set(msg, type, len, ++Msg_Id);
+    memcpy(msg + PIPE_MSG_HEADER, payload, len);
+    
+    if (DEBUG) printf("sending message %d, id %u : %s\n", type, Msg_Id, payload);
+    
+    if (write(p_fd_w, msg, PIPE_MSG_HEADER + len) != PIPE_MSG_HEADER + len) {
+        printf("Error during writing to EPD\n");
+        return(-1);
+    }
+    
+    do {
+        // reply is a header and the result
+        for (i = 0; i < PIPE_MSG_HEADER + 1; i += n) {
+            
+            if ((n = read(p_fd_r, msg + i, PIPE_MSG_HEADER + 1 - i)) <= 0) {
+                printf("Error during reading from EPD\n");
+                return(-1);
+            }
+        }
+        
+        if (pipe_msg_get(msg, &r_type, &r_len, &r_id) != 0 || r_type != PIPE_MSG_REPLY) {
+            printf("Unexpected reply from EPD\n");
+            return(-1);
+        }
+        
+        // result of an earlier message that was queued (epaper -A)
+        if (r_id != Msg_Id && DEBUG)
+            printf("message %u result %d\n", r_id, (int8_t) msg[PIPE_MSG_HEADER]);
+    
+    } while (r_id != Msg_Id);
+    
+    switch ((int8_t) msg[PIPE_MSG_HEADER]) {
+        case 0 :
+            if (DEBUG) printf("Successfull execution has been completed\n");
+            return(0);
+        
+        case PIPE_MSG_QUEUED:
+            if (DEBUG) printf("Queued for execution\n");
+            return(0);
+        
+        case PIPE_MSG_COALESCED:
+            if (DEBUG) printf("Performed, replaced by a later frame\n");
+            return(0);
+            
+        case -1:
+            if (DEBUG) printf("Execution error\n");
+            return(-1);
+            
+        case -2:
+            if (DEBUG) printf("Syntax error\n");
+            return(-1);
+            
+        case PIPE_MSG_OVERRUN:
+            printf("epaper has a buffer overrun. use debugger\n");
+            close_out(EXIT_FAILURE);
+            break;
+    }
+    
+    printf("Unknown return code %d\n", (int8_t) msg[PIPE_MSG_HEADER]);
+    return(-1);
+}
+
+/**
+ * @brief define a template on the EPD server
+ * 
+ * @param name : template name
+ * @param instruction : instructions with variables {name}
+ * 
+ * @return
+ * 0 succesfull
+ * -1 error
+ */
+int send_template(char *name, char *instruction)
+{
+    char    buf[MAXINSTRUCTIONS];
+    
+    if (Framed) {
+        snprintf(buf, sizeof(buf), "%s%s", name, instruction);
+        return(send_framed(PIPE_MSG_TEMPLATE, buf));
+    }
+    
+    sprintf(buf, "<<TEMPLATE %s>>", name);
+    
+    if (sent_to_pipe(buf, strlen(buf)) != 0) return(-1);
+    
+    // EPD asks for the instructions
+    if (read_EPD() != 1) {
+        if (DEBUG) printf("Template %s not accepted\n", name);
+        return(-1);
+    }
+    
+    return(send_EPD(instruction, strlen(instruction)));
+}
+
+/**
+ * @brief draw a template on the EPD server
+ * 
+ * @param name : template name
+ * @param values : var=value;var=value
+ * 
+ * @return
+ * 0 succesfull
+ * -1 error
+ */
+int send_render(char *name, char *values)
+{
+    char    buf[MAXINSTRUCTIONS];
+    
+    if (Framed) {
+        snprintf(buf, sizeof(buf), "%s %s", name, values);
+        return(send_framed(PIPE_MSG_RENDER, buf));
+    }
+    
+    snprintf(buf, sizeof(buf), "<<RENDER %s %s>>", name, values);
+    return(send_EPD(buf, strlen(buf)));
+}
+
 /**
  *  @brief create time or date display info
  * 
@@ -375,7 +593,19 @@ void start_clock()
    };
 
    printf("Starting Clock\n");
-    
+   
+   // the layout is sent once, each minute only the values
+   if (send_template("clock",
+        "<!=c, \
+        m=n,r=0,p={cx}:150, d=b,C=120:5,\
+        p={cx}:150,d=c,l={hx}:{hy}:0:3,\
+        p={cx}:150,l={mx}:{my}:0:2, \
+        d=c, p=85:{ry}, Q=550:{qy}:5, \
+        f='font24',p=90:{ty},d=b,t='{time},  {date}'>") != 0) {
+        printf("Could not sent clock template\n");
+        close_out(EXIT_FAILURE);
+   }
+
    while (1)
    {
         // clear buffer
@@ -452,19 +682,13 @@ void start_clock()
           
         // draw clock and add hour and minutes
         sprintf(buf,
-        "<!=c, \
-        m=n,r=0,p=%d:150, d=b,C=120:5,\
-        p=%d:150,d=c,l=%d:%d:0:3,\
-        p=%d:150,l=%d:%d:0:2, \
-        d=c, p=85:%d, Q=550:%d:5, \
-        f='font24',p=90:%d,d=b,t='%s,  %s'>",
-        clock_xoffset + 150,
+        "cx=%d;hx=%d;hy=%d;mx=%d;my=%d;ry=%d;qy=%d;ty=%d;time=%s;date=%s",
         clock_xoffset + 150, h_xend + clock_xoffset, h_yend, 
-        clock_xoffset + 150, m_xend + clock_xoffset, m_yend, 
+        m_xend + clock_xoffset, m_yend, 
         310 + time_offset, 315+time_offset, 
         280 + time_offset, time_buf, date_buf);
 
-        if (send_EPD(buf,strlen(buf)) != 0) {
+        if (send_render("clock", buf) != 0) {
             if (DEBUG) printf("stopping clock\n");
             close_out(EXIT_FAILURE);
         }
@@ -498,6 +722,8 @@ void usage()
     
     "-r     pipename read from named pipe (default %s)\n"
     "-w     pipename write to named pipe  (default %s)\n"
+    "-S     socket connect to unix socket instead of the pipes\n"
+    "-t     use text messages only (no framed messages)\n"
     "-d     show debug information\n"
     "-h     show this help information\n",
     VERSION,name_pipe_r,name_pipe_w);
@@ -510,7 +736,7 @@ int main(int argc, char *argv[])
 {
     int opt;
 
-    while ((opt = getopt(argc, argv, "dhHr:w:")) != -1) {
+    while ((opt = getopt(argc, argv, "dhHr:w:S:t")) != -1) {
         
         switch(opt){
             case 'r':           // pipe to read from
@@ -520,11 +746,19 @@ int main(int argc, char *argv[])
             case 'w':           // pipe to write to 
               strncpy(name_pipe_w, optarg,MAXFILENAME);
               break;
+
+            case 'S':           // unix socket instead of pipes
+              strncpy(name_socket, optarg,MAXFILENAME - 1);
+              break;
                 
             case 'd':           // debugger on
             case 'D':
                 DEBUG=true;
                 break;
+            
+            case 't':           // no framed messages
+                Text_Only = true;
+                break;
 
             case 'h':           // display help
             case 'H':
@@ -544,6 +778,9 @@ int main(int argc, char *argv[])
 
     /* connect the named pipes */
     connect_pipes();
+    
+    /* a complete instruction in one message */
+    if (! Text_Only) set_framed();
 
     /* start program */
     start_clock();